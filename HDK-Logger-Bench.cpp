@@ -0,0 +1,734 @@
+/** @file
+    @brief Implementation of a benchmark of the capture pipeline, driven by
+   simulated trackers.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Internal Includes
+#include "hdklogger/BatchDecoder.h"
+#include "hdklogger/BinaryWriter.h"
+#include "hdklogger/Capture.h"
+#include "hdklogger/Clock.h"
+#include "hdklogger/CompressedWriter.h"
+#include "hdklogger/Decoder.h"
+#include "hdklogger/Histogram.h"
+#include "hdklogger/HDK.h"
+#include "hdklogger/Options.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define HDKLOGGER_BENCH_MAPPED_CAPTURE
+#include "hdklogger/MappedCapture.h"
+#endif
+#include "hdklogger/SampleStore.h"
+#include "hdklogger/SharedRing.h"
+#include "hdklogger/SequenceTracker.h"
+#include "hdklogger/SimulatedDevice.h"
+#include "hdklogger/TextWriter.h"
+
+// Library/third-party includes
+#include "hidapipp/Device.h"
+
+// Standard includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+/// Benchmark settings from the command line.
+struct BenchOptions {
+    /// Reports pushed through each isolated stage.
+    std::uint64_t reports = 1000000;
+    /// Rate of the paced pipeline run, in reports per second.
+    double rate = 1000;
+    /// Length of the paced pipeline run, in seconds.
+    double pacedDuration = 2;
+    /// Scratch file for the stages that write.
+    std::string scratch = "hdk-logger-bench.tmp";
+    /// Where to write machine-readable results, if anywhere.
+    std::string json;
+};
+
+void print_usage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " [options]\n"
+              << "Options:\n"
+              << "  --reports=N           Reports per stage "
+                 "(default: 1000000)\n"
+              << "  --rate=HZ             Rate of the paced pipeline run "
+                 "(default: 1000)\n"
+              << "  --paced-duration=SECONDS\n"
+              << "                        Length of the paced pipeline run "
+                 "(default: 2)\n"
+              << "  --scratch=FILE        Scratch file for writing stages "
+                 "(default: hdk-logger-bench.tmp)\n"
+              << "  --json=FILE           Also write results as JSON to FILE\n";
+}
+
+bool parse_bench_options(int argc, char *argv[], BenchOptions &opts) {
+    std::string value;
+    for (int i = 1; i < argc; ++i) {
+        using hdklogger::detail::match_option;
+        using hdklogger::detail::parse_number;
+        const char *arg = argv[i];
+        bool ok = true;
+        if (match_option(arg, "--reports", value)) {
+            ok = parse_number(value, opts.reports) && opts.reports > 0;
+        } else if (match_option(arg, "--rate", value)) {
+            ok = parse_number(value, opts.rate) && opts.rate > 0;
+        } else if (match_option(arg, "--paced-duration", value)) {
+            ok = parse_number(value, opts.pacedDuration);
+        } else if (match_option(arg, "--scratch", value)) {
+            opts.scratch = value;
+        } else if (match_option(arg, "--json", value)) {
+            opts.json = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "Invalid argument: " << arg << "\n";
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Timing of one benchmark stage.
+struct StageResult {
+    std::string name;
+    std::uint64_t reports = 0;
+    double wallSeconds = 0;
+    double cpuSeconds = 0;
+
+    double reports_per_second() const { return double(reports) / wallSeconds; }
+    double wall_ns_per_report() const {
+        return wallSeconds * 1e9 / double(reports);
+    }
+    double cpu_ns_per_report() const {
+        return cpuSeconds * 1e9 / double(reports);
+    }
+};
+
+/// Measures wall-clock and process CPU time.
+class Stopwatch {
+  public:
+    Stopwatch()
+        : wallStart_(hdklogger::monotonic_now()), cpuStart_(std::clock()) {}
+
+    StageResult stop(std::string const &name, std::uint64_t reports) const {
+        StageResult ret;
+        ret.name = name;
+        ret.reports = reports;
+        ret.wallSeconds = double(hdklogger::monotonic_now() - wallStart_) / 1e9;
+        ret.cpuSeconds = double(std::clock() - cpuStart_) / CLOCKS_PER_SEC;
+        return ret;
+    }
+
+  private:
+    std::int64_t wallStart_;
+    std::clock_t cpuStart_;
+};
+
+/// Stream buffer discarding everything, so formatting can be timed without
+/// any I/O.
+class NullBuffer : public std::streambuf {
+  protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char *, std::streamsize n) override {
+        return n;
+    }
+};
+
+/// Keeps the compiler from optimizing away work whose result is unused.
+volatile std::uint64_t g_sink;
+
+hdklogger::SimulationSettings fast_simulation() {
+    hdklogger::SimulationSettings ret;
+    ret.realtime = false;
+    return ret;
+}
+
+/// A pool of realistic reports for the stages downstream of reading.
+std::vector<hdklogger::CapturedReport> make_pool(std::size_t n) {
+    std::vector<hdklogger::CapturedReport> ret(n);
+    hdklogger::SimulatedDevice dev{fast_simulation()};
+    for (auto &captured : ret) {
+        dev.read(captured.report);
+        captured.timestamp = hdklogger::monotonic_now();
+    }
+    return ret;
+}
+
+/// Stage: the hidapipp read wrapper (DeviceBase::read into an inline report),
+/// over a simulated device producing reports as fast as they are read.
+StageResult bench_read(std::uint64_t n) {
+    hdklogger::SimulatedDevice dev{fast_simulation()};
+    hdklogger::HDKReport report;
+    std::uint64_t bytes = 0;
+    Stopwatch watch;
+    for (std::uint64_t i = 0; i < n; ++i) {
+        dev.read(report);
+        bytes += report.size();
+    }
+    auto ret = watch.stop("read", n);
+    g_sink = bytes;
+    return ret;
+}
+
+/// Stage: DeviceBase::read_batch, as the capture thread uses it, with each
+/// report timestamped, over a simulated device producing reports as fast as
+/// they are read.
+StageResult bench_read_batch(std::uint64_t n) {
+    hdklogger::SimulatedDevice dev{fast_simulation()};
+    hdklogger::HDKReportBatch batch{hdklogger::READ_BATCH_SIZE};
+    std::uint64_t bytes = 0;
+    Stopwatch watch;
+    for (std::uint64_t i = 0; i < n; i += batch.size()) {
+        dev.read_batch(batch, std::size_t(n - i), 0,
+                       [] { return hdklogger::monotonic_now(); });
+        for (std::size_t j = 0; j < batch.size(); ++j) {
+            bytes += batch.length(j);
+        }
+    }
+    auto ret = watch.stop("read_batch", n);
+    g_sink = bytes;
+    return ret;
+}
+
+/// Stage: decoding each report in full, and the online statistics the capture
+/// thread keeps on them.
+StageResult
+bench_decode(std::vector<hdklogger::CapturedReport> const &pool,
+             std::uint64_t n) {
+    std::unique_ptr<hdklogger::SequenceTracker> seq(
+        new hdklogger::SequenceTracker);
+    std::unique_ptr<hdklogger::Histogram> hist(new hdklogger::Histogram);
+    std::int64_t last = 0;
+    hdklogger::Sample sample;
+    float sum = 0;
+    Stopwatch watch;
+    for (std::uint64_t i = 0; i < n; ++i) {
+        auto const &captured = pool[i % pool.size()];
+        hdklogger::decode(captured, sample);
+        sum += sample.orientation.w + sample.incrementalRotation.z;
+        seq->record(sample.sequence, captured.timestamp);
+        if (captured.timestamp > last) {
+            hist->record(std::uint64_t(captured.timestamp - last));
+        }
+        last = captured.timestamp;
+    }
+    auto ret = watch.stop("decode", n);
+    g_sink = std::uint64_t(sum) + seq->dropped();
+    return ret;
+}
+
+/// Binary capture records of the given reports, back to back.
+std::vector<std::uint8_t>
+make_records(std::vector<hdklogger::CapturedReport> const &reports) {
+    std::vector<std::uint8_t> ret(reports.size() *
+                                  hdklogger::binary::RECORD_SIZE);
+    for (std::size_t i = 0; i < reports.size(); ++i) {
+        auto const &captured = reports[i];
+        hdklogger::binary::encode_record(
+            captured.timestamp, captured.report.data(), captured.report.size(),
+            ret.data() + i * hdklogger::binary::RECORD_SIZE);
+    }
+    return ret;
+}
+
+/// Column storage for decode_records().
+struct Columns {
+    explicit Columns(std::size_t n)
+        : w(n), x(n), y(n), z(n), vx(n), vy(n), vz(n) {}
+    hdklogger::SampleColumns get() {
+        return hdklogger::SampleColumns{w.data(),  x.data(),  y.data(),
+                                        z.data(),  vx.data(), vy.data(),
+                                        vz.data()};
+    }
+    std::vector<float> w, x, y, z, vx, vy, vz;
+};
+
+/// Checks that a batch decoder kernel gives bit-for-bit what decode() does,
+/// on random reports of every version and length.
+bool verify_batch(hdklogger::DecodeKernel kernel) {
+    std::vector<hdklogger::CapturedReport> reports(4099);
+    hdklogger::SplitMix64 rng{42};
+    for (auto &captured : reports) {
+        auto len = std::size_t(rng.next() %
+                               (hdklogger::HDK_MAX_REPORT_LENGTH + 1));
+        captured.report.resize(len);
+        for (auto &byte : captured.report) {
+            byte = hidapi::DataByte(rng.next());
+        }
+        captured.timestamp = std::int64_t(rng.next() >> 1);
+    }
+    auto records = make_records(reports);
+    Columns columns{reports.size()};
+    hdklogger::decode_records(records.data(), reports.size(), columns.get(),
+                              kernel);
+    auto same = [](float a, float b) {
+        return 0 == std::memcmp(&a, &b, sizeof(float));
+    };
+    for (std::size_t i = 0; i < reports.size(); ++i) {
+        hdklogger::Sample sample;
+        if (!hdklogger::decode_record(
+                records.data() + i * hdklogger::binary::RECORD_SIZE, sample)) {
+            continue;
+        }
+        auto const &q = sample.orientation;
+        auto const &v = sample.incrementalRotation;
+        if (!same(q.w, columns.w[i]) || !same(q.x, columns.x[i]) ||
+            !same(q.y, columns.y[i]) || !same(q.z, columns.z[i]) ||
+            !same(v.x, columns.vx[i]) || !same(v.y, columns.vy[i]) ||
+            !same(v.z, columns.vz[i])) {
+            std::cerr << "Batch decoder " << hdklogger::to_string(kernel)
+                      << " differs from decode() on report " << i << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Stage: batch decoding binary capture records into columns, with the
+/// given kernel.
+StageResult bench_decode_records(std::vector<std::uint8_t> const &records,
+                               std::uint64_t n,
+                               hdklogger::DecodeKernel kernel) {
+    auto perBatch = records.size() / hdklogger::binary::RECORD_SIZE;
+    Columns columns{perBatch};
+    auto out = columns.get();
+    std::uint64_t done = 0;
+    float sum = 0;
+    Stopwatch watch;
+    while (done < n) {
+        auto count = std::size_t(std::min<std::uint64_t>(perBatch, n - done));
+        hdklogger::decode_records(records.data(), count, out, kernel);
+        sum += out.w[count - 1];
+        done += count;
+    }
+    auto ret = watch.stop(
+        std::string("decode_records_") + hdklogger::to_string(kernel), n);
+    g_sink = std::uint64_t(sum);
+    return ret;
+}
+
+/// Stage: decoding reports into a SampleStore one at a time, as the capture
+/// pipeline does through SampleStoreSink.
+StageResult bench_store(std::vector<hdklogger::CapturedReport> const &pool,
+                        std::uint64_t n) {
+    hdklogger::SampleStore store;
+    hdklogger::SampleStoreSink sink{store};
+    Stopwatch watch;
+    for (std::uint64_t i = 0; i < n; ++i) {
+        sink.write(pool[i % pool.size()]);
+    }
+    auto ret = watch.stop("store_append", n);
+    g_sink = store.size();
+    return ret;
+}
+
+/// Stage: batch decoding binary capture records into a SampleStore.
+StageResult bench_store_records(std::vector<std::uint8_t> const &records,
+                                std::uint64_t n) {
+    auto perBatch = records.size() / hdklogger::binary::RECORD_SIZE;
+    hdklogger::SampleStore store;
+    std::uint64_t done = 0;
+    Stopwatch watch;
+    while (done < n) {
+        auto count = std::size_t(std::min<std::uint64_t>(perBatch, n - done));
+        store.append_records(records.data(), count);
+        done += count;
+    }
+    auto ret = watch.stop("store_records", n);
+    g_sink = store.size();
+    return ret;
+}
+
+#ifdef HDKLOGGER_BENCH_MAPPED_CAPTURE
+/// Stage: offline analysis of a capture file: mapping it and batch decoding
+/// all its records into a SampleStore. The file is written first, untimed,
+/// so it is in the page cache.
+StageResult bench_mapped(std::vector<hdklogger::CapturedReport> const &pool,
+                         std::uint64_t n, std::string const &path) {
+    {
+        hdklogger::BinaryWriter writer{path, hdklogger::binary::Header{}};
+        for (std::uint64_t i = 0; i < n; ++i) {
+            writer.write(pool[i % pool.size()]);
+        }
+        writer.finish();
+    }
+    hdklogger::SampleStore store;
+    Stopwatch watch;
+    {
+        hdklogger::MappedCapture capture{path};
+        store.append_records(capture.record_ptr(0), capture.size());
+    }
+    auto ret = watch.stop("mapped_decode", n);
+    g_sink = store.size();
+    std::remove(path.c_str());
+    return ret;
+}
+#endif
+
+/// Stage: formatting the text output, into a stream that discards it.
+StageResult
+bench_format(std::vector<hdklogger::CapturedReport> const &pool,
+             std::uint64_t n) {
+    NullBuffer buf;
+    std::ostream os(&buf);
+    hdklogger::TextWriter writer{os, hdklogger::make_clock_anchor()};
+    Stopwatch watch;
+    for (std::uint64_t i = 0; i < n; ++i) {
+        writer.write(pool[i % pool.size()]);
+    }
+    writer.finish();
+    return watch.stop("format", n);
+}
+
+/// Stage: writing the binary format to a file, synced according to
+/// @p policy. Reports the time taken by each write and sync on stderr.
+StageResult bench_write(std::vector<hdklogger::CapturedReport> const &pool,
+                        std::uint64_t n, std::string const &path,
+                        hdklogger::SyncPolicy policy) {
+    auto name = std::string("write");
+    if (policy != hdklogger::SyncPolicy::None) {
+        name = name + "_" + hdklogger::to_string(policy);
+    }
+    hdklogger::GroupCommitSettings settings;
+    settings.sync = policy;
+    /// Sync as often as the rest of the writing allows.
+    settings.syncInterval = 0;
+    Stopwatch watch;
+    {
+        hdklogger::BinaryWriter writer{path, hdklogger::binary::Header{},
+                                       settings};
+        for (std::uint64_t i = 0; i < n; ++i) {
+            writer.write(pool[i % pool.size()]);
+        }
+        if (!writer.finish()) {
+            std::cerr << "Error writing " << path << std::endl;
+        }
+        auto const &file = writer.file();
+        if (file.policy() != policy) {
+            std::cerr << name << ": not supported here, measured "
+                      << hdklogger::to_string(file.policy()) << " instead"
+                      << std::endl;
+        }
+        auto us = [](hdklogger::Histogram const &hist, double pct) {
+            return double(hist.percentile(pct)) / 1000.;
+        };
+        std::cerr << name << ": " << file.write_latency().count()
+                  << " writes, p50 " << us(file.write_latency(), 50)
+                  << " us, max " << us(file.write_latency(), 100) << " us";
+        if (file.sync_latency().count()) {
+            std::cerr << "; " << file.sync_latency().count()
+                      << " syncs, p50 " << us(file.sync_latency(), 50)
+                      << " us, max " << us(file.sync_latency(), 100) << " us";
+        }
+        std::cerr << std::endl;
+    }
+    auto ret = watch.stop(name, n);
+    std::remove(path.c_str());
+    return ret;
+}
+
+/// Stage: writing the block-compressed format to a file with a given codec.
+/// Reports the compressed size relative to the binary format on stderr.
+StageResult bench_compressed(std::vector<hdklogger::CapturedReport> const &pool,
+                             std::uint64_t n, std::string const &path,
+                             hdklogger::Codec codec) {
+    Stopwatch watch;
+    std::uint64_t bytesIn = 0;
+    std::uint64_t bytesOut = 0;
+    {
+        hdklogger::CompressedWriter writer{path, hdklogger::binary::Header{},
+                                           codec};
+        for (std::uint64_t i = 0; i < n; ++i) {
+            writer.write(pool[i % pool.size()]);
+        }
+        if (!writer.finish()) {
+            std::cerr << "Error writing " << path << std::endl;
+        }
+        bytesIn = writer.bytes_in();
+        bytesOut = writer.bytes_out();
+    }
+    auto ret =
+        watch.stop(std::string("compressed_") + hdklogger::to_string(codec), n);
+    std::remove(path.c_str());
+    if (bytesOut) {
+        std::cerr << ret.name << ": " << bytesIn << " -> " << bytesOut
+                  << " bytes (ratio " << double(bytesIn) / double(bytesOut)
+                  << ")" << std::endl;
+    }
+    return ret;
+}
+
+#ifdef HDKLOGGER_HAVE_SHARED_RING
+/// Stage: publishing reports in a shared-memory ring while a reader on
+/// another thread takes them as they arrive. Reports how many the reader got
+/// on stderr.
+StageResult bench_publish(std::vector<hdklogger::CapturedReport> const &pool,
+                          std::uint64_t n) {
+    auto name = "/hdk-logger-bench-" + std::to_string(::getpid());
+    hdklogger::SharedRingPublisher publisher{name, "BENCH",
+                                             hdklogger::make_clock_anchor()};
+    hdklogger::SharedRingReader reader{name};
+    std::atomic<bool> done{false};
+    std::uint64_t received = 0;
+    std::thread consumer([&] {
+        std::int64_t timestamp;
+        hdklogger::HDKReport report;
+        for (;;) {
+            auto finished = done.load();
+            if (reader.next(timestamp, report)) {
+                ++received;
+            } else if (finished) {
+                return;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    Stopwatch watch;
+    for (std::uint64_t i = 0; i < n; ++i) {
+        auto const &captured = pool[i % pool.size()];
+        publisher.publish(captured.timestamp, captured.report.data(),
+                          captured.report.size());
+    }
+    auto ret = watch.stop("publish", n);
+    done = true;
+    consumer.join();
+    std::cerr << "publish: reader got " << received << ", lost "
+              << reader.lost() << std::endl;
+    return ret;
+}
+#endif
+
+/// Sink wrapper recording, for each report, the time from the read returning
+/// to the report having been handed to the wrapped sink.
+template <typename Sink> class LatencySink {
+  public:
+    LatencySink(std::unique_ptr<Sink> &&sink, hdklogger::Histogram &latency)
+        : sink_(std::move(sink)), latency_(latency) {}
+
+    void write(hdklogger::CapturedReport const &captured) {
+        sink_->write(captured);
+        latency_.record(
+            std::uint64_t(hdklogger::monotonic_now() - captured.timestamp));
+    }
+
+    bool finish() { return sink_->finish(); }
+
+    Sink &sink() { return *sink_; }
+
+  private:
+    std::unique_ptr<Sink> sink_;
+    hdklogger::Histogram &latency_;
+};
+
+/// Passes polls on to the wrapped sink.
+template <typename Sink> void poll_sink(LatencySink<Sink> &sink) {
+    using hdklogger::poll_sink;
+    poll_sink(sink.sink());
+}
+
+/// Results of a run of the whole capture pipeline.
+struct PipelineResult {
+    StageResult stage;
+    std::uint64_t read = 0;
+    std::uint64_t overflows = 0;
+    std::unique_ptr<hdklogger::Histogram> latency{new hdklogger::Histogram};
+};
+
+/// Runs the whole pipeline (capture thread, ring, output thread, binary
+/// writer) on a simulated device until it has produced @p n reports.
+PipelineResult bench_pipeline(std::string const &name,
+                              hdklogger::SimulationSettings const &settings,
+                              std::uint64_t n, std::string const &path) {
+    PipelineResult ret;
+    using Sink = LatencySink<hdklogger::BinaryWriter>;
+    using Channel = hdklogger::CaptureChannel<hdklogger::SimulatedDevice, Sink>;
+    std::vector<std::unique_ptr<Channel>> channels;
+    Stopwatch watch;
+    channels.emplace_back(new Channel{
+        hdklogger::DeviceInfo{}, hdklogger::SimulatedDevice{settings},
+        std::unique_ptr<Sink>{new Sink{
+            std::unique_ptr<hdklogger::BinaryWriter>{
+                new hdklogger::BinaryWriter{path, hdklogger::binary::Header{}}},
+            *ret.latency}}});
+    auto &reader = channels.front()->reader();
+    reader.set_max_reports(n);
+    reader.start();
+    std::thread output([&] { hdklogger::drain_channels(channels); });
+    while (reader.running()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    reader.stop();
+    output.join();
+    channels.front()->sink().finish();
+    ret.read = reader.reports();
+    ret.overflows = channels.front()->ring().overflows();
+    ret.stage = watch.stop(name, ret.read - ret.overflows);
+    std::remove(path.c_str());
+    return ret;
+}
+
+void print_stage(StageResult const &stage) {
+    std::printf("%-22s %12llu %14.0f %12.1f %12.1f\n", stage.name.c_str(),
+                static_cast<unsigned long long>(stage.reports),
+                stage.reports_per_second(), stage.wall_ns_per_report(),
+                stage.cpu_ns_per_report());
+}
+
+void print_latency(PipelineResult const &result) {
+    auto const &h = *result.latency;
+    std::printf("%-22s read %llu, dropped at ring %llu; read-to-write latency "
+                "(us): p50 %.1f p99 %.1f p99.9 %.1f max %.1f\n",
+                result.stage.name.c_str(),
+                static_cast<unsigned long long>(result.read),
+                static_cast<unsigned long long>(result.overflows),
+                double(h.percentile(50)) / 1e3, double(h.percentile(99)) / 1e3,
+                double(h.percentile(99.9)) / 1e3, double(h.max()) / 1e3);
+}
+
+void write_stage_json(std::ostream &os, StageResult const &stage) {
+    os << "    {\"name\": \"" << stage.name
+       << "\", \"reports\": " << stage.reports
+       << ", \"wall_seconds\": " << stage.wallSeconds
+       << ", \"cpu_seconds\": " << stage.cpuSeconds
+       << ", \"reports_per_second\": " << stage.reports_per_second()
+       << ", \"wall_ns_per_report\": " << stage.wall_ns_per_report()
+       << ", \"cpu_ns_per_report\": " << stage.cpu_ns_per_report();
+}
+
+void write_pipeline_json(std::ostream &os, PipelineResult const &result) {
+    write_stage_json(os, result.stage);
+    auto const &h = *result.latency;
+    os << ", \"read\": " << result.read
+       << ", \"ring_overflows\": " << result.overflows
+       << ", \"latency_ns\": {\"p50\": " << h.percentile(50)
+       << ", \"p90\": " << h.percentile(90)
+       << ", \"p99\": " << h.percentile(99)
+       << ", \"p99.9\": " << h.percentile(99.9) << ", \"max\": " << h.max()
+       << "}}";
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    BenchOptions opts;
+    if (!parse_bench_options(argc, argv, opts)) {
+        return -1;
+    }
+
+    auto pool = make_pool(4096);
+    std::vector<StageResult> stages;
+    stages.push_back(bench_read(opts.reports));
+    stages.push_back(bench_read_batch(opts.reports));
+    stages.push_back(bench_decode(pool, opts.reports));
+    auto records = make_records(pool);
+    for (auto kernel :
+         {hdklogger::DecodeKernel::Scalar, hdklogger::DecodeKernel::SSE2,
+          hdklogger::DecodeKernel::AVX2}) {
+        if (!hdklogger::kernel_supported(kernel)) {
+            continue;
+        }
+        if (!verify_batch(kernel)) {
+            return -1;
+        }
+        stages.push_back(bench_decode_records(records, opts.reports, kernel));
+    }
+    stages.push_back(bench_store(pool, opts.reports));
+    stages.push_back(bench_store_records(records, opts.reports));
+#ifdef HDKLOGGER_BENCH_MAPPED_CAPTURE
+    stages.push_back(bench_mapped(pool, opts.reports, opts.scratch));
+#endif
+    stages.push_back(bench_format(pool, opts.reports));
+    for (auto policy : {hdklogger::SyncPolicy::None,
+                        hdklogger::SyncPolicy::Periodic,
+                        hdklogger::SyncPolicy::Direct}) {
+        if (hdklogger::sync_policy_available(policy)) {
+            stages.push_back(
+                bench_write(pool, opts.reports, opts.scratch, policy));
+        }
+    }
+    for (auto codec : {hdklogger::Codec::None, hdklogger::Codec::LZ4,
+                       hdklogger::Codec::Zstd, hdklogger::Codec::Deflate}) {
+        if (hdklogger::codec_available(codec)) {
+            stages.push_back(
+                bench_compressed(pool, opts.reports, opts.scratch, codec));
+        }
+    }
+#ifdef HDKLOGGER_HAVE_SHARED_RING
+    stages.push_back(bench_publish(pool, opts.reports));
+#endif
+
+    std::vector<PipelineResult> pipelines;
+    /// Flat out: the ceiling of the whole pipeline.
+    pipelines.push_back(bench_pipeline("pipeline_max", fast_simulation(),
+                                       opts.reports, opts.scratch));
+    /// Paced like a real tracker: the latency it would see.
+    hdklogger::SimulationSettings paced;
+    paced.rate = opts.rate;
+    pipelines.push_back(bench_pipeline(
+        "pipeline_paced", paced,
+        std::uint64_t(opts.rate * opts.pacedDuration) + 1, opts.scratch));
+
+    std::printf("%-22s %12s %14s %12s %12s\n", "stage", "reports",
+                "reports/s", "wall ns/rpt", "cpu ns/rpt");
+    for (auto const &stage : stages) {
+        print_stage(stage);
+    }
+    for (auto const &pipeline : pipelines) {
+        print_stage(pipeline.stage);
+    }
+    for (auto const &pipeline : pipelines) {
+        print_latency(pipeline);
+    }
+
+    if (!opts.json.empty()) {
+        std::ofstream os(opts.json);
+        os << "{\n  \"benchmark\": \"hdk-logger-bench\",\n"
+           << "  \"format_version\": 1,\n  \"stages\": [\n";
+        for (std::size_t i = 0; i < stages.size(); ++i) {
+            write_stage_json(os, stages[i]);
+            os << "},\n";
+        }
+        for (std::size_t i = 0; i < pipelines.size(); ++i) {
+            write_pipeline_json(os, pipelines[i]);
+            os << (i + 1 < pipelines.size() ? ",\n" : "\n");
+        }
+        os << "  ]\n}\n";
+        if (!os) {
+            std::cerr << "Error writing " << opts.json << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+/** @file
+    @brief Implementation of hdk-logger-stat, which shows the live statistics a
+   running hdk-logger serves on its statistics socket.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Internal Includes
+#include "hdklogger/StatsServer.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+/// Client settings from the command line.
+struct StatOptions {
+    /// Path of the logger's statistics socket.
+    std::string socket;
+    /// Seconds between snapshots: 0 takes just one.
+    double interval = 0;
+    /// Print snapshots as served, rather than as a table.
+    bool raw = false;
+};
+
+void print_usage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " [options] SOCKET\n"
+              << "Shows the statistics hdk-logger --stats-socket=SOCKET "
+                 "serves.\n"
+              << "Options:\n"
+              << "  --watch=SECONDS       Show them again this often, with "
+                 "rates, until\n"
+              << "                        interrupted or the logger exits\n"
+              << "  --raw                 Print snapshots as served "
+                 "(key=value fields)\n";
+}
+
+bool parse_stat_options(int argc, char *argv[], StatOptions &opts) {
+    static const char WATCH[] = "--watch=";
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool ok = true;
+        if (0 == std::strncmp(arg, WATCH, sizeof(WATCH) - 1)) {
+            char *end = nullptr;
+            auto value = arg + sizeof(WATCH) - 1;
+            opts.interval = std::strtod(value, &end);
+            ok = *value && *end == '\0' && opts.interval > 0;
+        } else if (0 == std::strcmp(arg, "--raw")) {
+            opts.raw = true;
+        } else if (arg[0] != '-' && opts.socket.empty()) {
+            opts.socket = arg;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "Invalid argument: " << arg << "\n";
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (opts.socket.empty()) {
+        print_usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+/// Prints a snapshot as a table. With the previous one, reports per second
+/// are over the time between them; otherwise, over the whole capture.
+void print_table(std::vector<hdklogger::StatsRecord> const &snapshot,
+                 std::vector<hdklogger::StatsRecord> const &previous) {
+    std::int64_t time = 0;
+    std::int64_t elapsed = 0;
+    for (auto const &record : snapshot) {
+        if (record.type == "hdk-logger") {
+            time = std::int64_t(record.number("time_ns"));
+            elapsed = std::int64_t(record.number("uptime_ns"));
+        }
+    }
+    std::map<std::string, std::uint64_t> previousReports;
+    for (auto const &record : previous) {
+        if (record.type == "hdk-logger") {
+            elapsed = time - std::int64_t(record.number("time_ns"));
+        } else if (record.type == "device") {
+            previousReports[record.fields.at("label")] =
+                record.number("reports");
+        }
+    }
+    std::printf("%-16s %12s %10s %9s %11s %9s %9s %9s %9s %9s\n", "device",
+                "reports", "rate/s", "ring drop", "queue", "seq drop",
+                "dup/reord", "p50 us", "p99 us", "max us");
+    for (auto const &record : snapshot) {
+        if (record.type != "device") {
+            continue;
+        }
+        auto const &label = record.fields.at("label");
+        auto reports = record.number("reports");
+        auto before = previousReports[label];
+        auto rate = elapsed > 0 ? double(reports - before) * 1e9 /
+                                      double(elapsed)
+                                : 0.;
+        auto queue = std::to_string(record.number("queue_depth")) + "/" +
+                     std::to_string(record.number("queue_capacity"));
+        auto dupReord = std::to_string(record.number("duplicated")) + "/" +
+                        std::to_string(record.number("reordered"));
+        auto us = [&](const char *key) {
+            return double(record.number(key)) / 1000.;
+        };
+        std::printf("%-16s %12llu %10.1f %9llu %11s %9llu %9s %9.1f %9.1f "
+                    "%9.1f\n",
+                    label.c_str(), (unsigned long long)reports, rate,
+                    (unsigned long long)record.number("ring_dropped"),
+                    queue.c_str(),
+                    (unsigned long long)record.number("seq_dropped"),
+                    dupReord.c_str(), us("interarrival_p50_ns"),
+                    us("interarrival_p99_ns"), us("interarrival_max_ns"));
+    }
+    std::fflush(stdout);
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    StatOptions opts;
+    if (!parse_stat_options(argc, argv, opts)) {
+        return -1;
+    }
+#ifdef HDKLOGGER_HAVE_STATS_SERVER
+    std::vector<hdklogger::StatsRecord> previous;
+    for (;;) {
+        std::string snapshot;
+        std::string error;
+        if (!hdklogger::fetch_stats(opts.socket, snapshot, error)) {
+            if (!previous.empty()) {
+                /// The logger has finished.
+                return 0;
+            }
+            std::cerr << "Could not get statistics from " << opts.socket
+                      << ": " << error << std::endl;
+            return -1;
+        }
+        auto records = hdklogger::parse_stats(snapshot);
+        if (opts.raw) {
+            std::cout << snapshot << std::flush;
+        } else {
+            print_table(records, previous);
+        }
+        if (opts.interval <= 0) {
+            return 0;
+        }
+        previous = records;
+        std::this_thread::sleep_for(
+            std::chrono::duration<double>(opts.interval));
+    }
+#else
+    std::cerr << "Unix domain sockets aren't supported on this platform"
+              << std::endl;
+    return -1;
+#endif
+}
@@ -0,0 +1,147 @@
+/** @file
+    @brief Implementation of hdk-logger-tail, which prints the reports a
+   running hdk-logger publishes in shared memory.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Internal Includes
+#include "hdklogger/Capture.h"
+#include "hdklogger/SharedRing.h"
+#include "hdklogger/Signals.h"
+#include "hdklogger/TextWriter.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+/// Client settings from the command line.
+struct TailOptions {
+    /// Name of the shared memory object hdk-logger publishes in.
+    std::string name;
+    /// Start with the oldest report still held, not the next one published.
+    bool fromOldest = false;
+    /// Include decoded orientation and angular velocity.
+    bool decode = false;
+};
+
+void print_usage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " [options] NAME\n"
+              << "Prints the reports hdk-logger --publish=NAME publishes, "
+                 "until interrupted or\n"
+              << "the logger exits.\n"
+              << "Options:\n"
+              << "  --oldest              Start with the oldest report still "
+                 "held, rather than the\n"
+              << "                        next one published\n"
+              << "  --decode              Add decoded orientation and "
+                 "angular velocity\n";
+}
+
+bool parse_tail_options(int argc, char *argv[], TailOptions &opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (0 == std::strcmp(arg, "--oldest")) {
+            opts.fromOldest = true;
+        } else if (0 == std::strcmp(arg, "--decode")) {
+            opts.decode = true;
+        } else if (arg[0] != '-' && opts.name.empty()) {
+            opts.name = arg;
+        } else {
+            std::cerr << "Invalid argument: " << arg << "\n";
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (opts.name.empty()) {
+        print_usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    TailOptions opts;
+    if (!parse_tail_options(argc, argv, opts)) {
+        return -1;
+    }
+#ifdef HDKLOGGER_HAVE_SHARED_RING
+    hdklogger::install_stop_signal_handlers();
+    try {
+        hdklogger::SharedRingReader reader{opts.name};
+        if (opts.fromOldest) {
+            reader.rewind();
+        }
+        hdklogger::TextWriter writer{std::cout, reader.anchor()};
+        writer.set_decode(opts.decode);
+        hdklogger::CapturedReport captured;
+        while (!hdklogger::stop_signal_received()) {
+            if (reader.next(captured.timestamp, captured.report)) {
+                writer.write(captured);
+                continue;
+            }
+            /// Caught up: show what we have, and stop if that's all there
+            /// will be.
+            writer.finish();
+            if (reader.closed()) {
+                break;
+            }
+            if (!reader.publisher_running()) {
+                /// Killed or crashed: take anything published meanwhile.
+                while (reader.next(captured.timestamp, captured.report)) {
+                    writer.write(captured);
+                }
+                writer.finish();
+                std::cerr << "The publisher of " << reader.name()
+                          << " has exited without closing it" << std::endl;
+                return -1;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (!writer.finish()) {
+            return -1;
+        }
+        if (reader.lost()) {
+            std::cerr << reader.lost()
+                      << " reports were overwritten before they could be "
+                         "printed"
+                      << std::endl;
+        }
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+#else
+    std::cerr << "Shared memory publishing isn't supported on this platform"
+              << std::endl;
+    return -1;
+#endif
+}
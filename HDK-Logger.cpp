@@ -23,7 +23,25 @@
 // limitations under the License.
 
 // Internal Includes
-// - none
+#include "hdklogger/BinaryWriter.h"
+#include "hdklogger/Capture.h"
+#include "hdklogger/Clock.h"
+#include "hdklogger/CompressedWriter.h"
+#include "hdklogger/DeviceInfo.h"
+#include "hdklogger/HDK.h"
+#include "hdklogger/NullWriter.h"
+#include "hdklogger/Options.h"
+#include "hdklogger/ReplayDevice.h"
+#include "hdklogger/Signals.h"
+#include "hdklogger/SharedRing.h"
+#include "hdklogger/SimulatedDevice.h"
+#include "hdklogger/StatsServer.h"
+#include "hdklogger/TextWriter.h"
+#include "hdklogger/Trace.h"
+
+#ifdef HDKLOGGER_HAVE_HIDRAW
+#include "hdklogger/HidrawDevice.h"
+#endif
 
 // Library/third-party includes
 #include "hidapipp/hidapipp.h"
@@ -31,11 +49,484 @@
 // Standard includes
 #include <stdio.h>
 #include <iostream>
+#include <algorithm>
+#include <cctype>
 #include <chrono>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Prints the percentiles of a histogram of nanosecond times, in
+/// microseconds.
+static void print_percentiles(hdklogger::Histogram const &hist,
+                              std::ostream &os) {
+    auto us = [&](double pct) { return double(hist.percentile(pct)) / 1000.; };
+    os << "p50 " << us(50) << ", p90 " << us(90) << ", p99 " << us(99)
+       << ", p99.9 " << us(99.9) << ", max " << double(hist.max()) / 1000.
+       << " (" << hist.count() << " samples)";
+}
+
+/// Prints statistics about writing a device's output: by default, none.
+template <typename Sink>
+static void print_sink_stats(Sink const &, std::ostream &) {}
+
+/// @overload
+static void print_sink_stats(hdklogger::BinaryWriter const &writer,
+                             std::ostream &os) {
+    auto const &file = writer.file();
+    os << "Write time (us): ";
+    print_percentiles(file.write_latency(), os);
+    os << "\n";
+    if (file.sync_latency().count()) {
+        os << "Sync time (us): ";
+        print_percentiles(file.sync_latency(), os);
+        os << "\n";
+    }
+}
+
+/// Prints the capture statistics gathered so far for a device.
+template <typename Channel>
+static void print_stats(Channel const &channel, std::ostream &os) {
+    auto const &reader = channel.reader();
+    auto const &seq = reader.sequence();
+    os << "[" << channel.label() << "] Reports read: " << reader.reports()
+       << " Dropped (output fell behind): " << channel.ring().overflows()
+       << "\nSequence numbers: dropped " << seq.dropped() << " (in "
+       << seq.gaps() << " gaps), duplicated " << seq.duplicated()
+       << ", reordered " << seq.reordered() << "\n";
+    os << "Inter-arrival time (us): ";
+    print_percentiles(reader.inter_arrival(), os);
+    os << "\n";
+    print_sink_stats(channel.sink(), os);
+    os << std::flush;
+}
+
+/// @overload
+template <typename Channel>
+static void print_stats(std::vector<std::unique_ptr<Channel>> const &channels,
+                        std::ostream &os) {
+    for (auto const &channel : channels) {
+        print_stats(*channel, os);
+    }
+}
+
+/// Writes what has been traced so far to the trace file, if tracing.
+static void write_trace(hdklogger::Options const &opts) {
+    if (opts.trace.empty()) {
+        return;
+    }
+    std::uint64_t lost = 0;
+    if (!hdklogger::Tracer::instance().write_chrome_trace(opts.trace, &lost)) {
+        std::cerr << "Could not write trace to " << opts.trace << std::endl;
+        return;
+    }
+    std::cerr << "Wrote trace to " << opts.trace;
+    if (lost) {
+        std::cerr << " (" << lost
+                  << " older events overwritten: see --trace-events)";
+    }
+    std::cerr << std::endl;
+}
+
+/// Works out a device's output file name: with several devices, %s in the
+/// pattern (or, failing that, a suffix before the extension) is replaced by
+/// the serial number, or the device's index if it has none.
+static std::string output_path(std::string const &pattern,
+                               hdklogger::DeviceInfo const &info,
+                               std::size_t index, std::size_t count) {
+    if (count == 1 || pattern.empty() || pattern == "-") {
+        return pattern;
+    }
+    auto id = std::string{};
+    for (auto c : info.serialNumber) {
+        id.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+    }
+    if (id.empty()) {
+        id = "dev" + std::to_string(index);
+    }
+    auto ret = pattern;
+    auto placeholder = ret.find("%s");
+    if (placeholder != std::string::npos) {
+        return ret.replace(placeholder, 2, id);
+    }
+    auto dot = ret.rfind('.');
+    auto slash = ret.find_last_of("/\\");
+    if (dot == std::string::npos ||
+        (slash != std::string::npos && dot < slash)) {
+        dot = ret.size();
+    }
+    return ret.insert(dot, "-" + id);
+}
+
+#ifdef HDKLOGGER_HAVE_STATS_SERVER
+/// Starts serving live statistics for the channels, if asked to. Failing to
+/// is reported, but doesn't stop the capture.
+template <typename Channel>
+static std::unique_ptr<hdklogger::StatsServer>
+serve_stats(hdklogger::Options const &opts,
+            std::vector<std::unique_ptr<Channel>> const &channels) {
+    std::unique_ptr<hdklogger::StatsServer> ret;
+    if (opts.statsSocket.empty()) {
+        return ret;
+    }
+    auto start = hdklogger::monotonic_now();
+    try {
+        ret.reset(new hdklogger::StatsServer{opts.statsSocket, [&, start] {
+            std::vector<hdklogger::DeviceStats> devices;
+            for (auto const &channel : channels) {
+                devices.push_back(hdklogger::collect_device_stats(*channel));
+            }
+            auto now = hdklogger::monotonic_now();
+            return hdklogger::format_stats(now, now - start, devices);
+        }});
+    } catch (std::exception &e) {
+        std::cerr << e.what() << ": continuing without the statistics socket"
+                  << std::endl;
+    }
+    return ret;
+}
+#endif
+
+#ifdef HDKLOGGER_HAVE_SHARED_RING
+/// Creates a shared-memory ring for each channel, if asked to, and has its
+/// capture thread publish every report there. Returns false (having said
+/// why) if one can't be created.
+template <typename Channel>
+static bool publish_reports(
+    hdklogger::Options const &opts,
+    std::vector<std::unique_ptr<Channel>> &channels,
+    std::vector<std::unique_ptr<hdklogger::SharedRingPublisher>> &publishers) {
+    if (opts.publish.empty()) {
+        return true;
+    }
+    /// The default, or an overload found by argument-dependent lookup.
+    using hdklogger::clock_anchor;
+    auto n = channels.size();
+    for (std::size_t i = 0; i < n; ++i) {
+        auto &channel = *channels[i];
+        auto name = output_path(opts.publish, channel.info(), i, n);
+        try {
+            publishers.emplace_back(new hdklogger::SharedRingPublisher{
+                name, channel.info().serialNumber,
+                clock_anchor(channel.device())});
+        } catch (std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return false;
+        }
+        auto publisher = publishers.back().get();
+        channel.reader().set_publisher(
+            [publisher](std::int64_t timestamp, hidapi::DataByte const *data,
+                        std::size_t length) {
+                publisher->publish(timestamp, data, length);
+            });
+        std::cerr << "[" << channel.label() << "] Publishing reports in "
+                  << publisher->name() << std::endl;
+    }
+    return true;
+}
+#endif
+
+/// Captures reports from every channel's device into its sink until done,
+/// returning the process exit code.
+template <typename Channel>
+static int capture(hdklogger::Options const &opts,
+                   std::vector<std::unique_ptr<Channel>> &channels) {
+    auto const &realtime = opts.realtime;
+    if (realtime.lockMemory) {
+        std::string error;
+        if (!hdklogger::lock_memory(error)) {
+            std::cerr << "Can't lock memory (" << error
+                      << "): continuing without" << std::endl;
+        }
+    }
+
+#ifdef HDKLOGGER_HAVE_SHARED_RING
+    /// Declared before the capture threads start, so the rings outlive them.
+    std::vector<std::unique_ptr<hdklogger::SharedRingPublisher>> publishers;
+    if (!publish_reports(opts, channels, publishers)) {
+        return -1;
+    }
+#endif
+
+    /// One capture thread per device.
+    for (auto &channel : channels) {
+        if (realtime.lockMemory) {
+            channel->ring().prefault();
+        }
+        auto label = channel->label();
+        channel->reader().set_thread_setup([&realtime, label] {
+            hdklogger::trace_thread_name("capture " + label);
+            /// One write, so messages from several threads don't interleave.
+            std::string messages;
+            for (auto const &failure :
+                 hdklogger::apply_to_current_thread(realtime)) {
+                messages += "[" + label + "] Capture thread " + failure +
+                            ": continuing without\n";
+            }
+            std::cerr << messages << std::flush;
+        });
+        channel->reader().set_max_reports(opts.count);
+        channel->reader().start();
+    }
+
+#ifdef HDKLOGGER_HAVE_STATS_SERVER
+    /// Serves statistics until the capture is over.
+    auto statsServer = serve_stats(opts, channels);
+#endif
+
+    /// Output thread: drains the rings into the sinks, so a slow terminal or
+    /// disk never delays the next read. Started after the readers, since it
+    /// quits once no reader is running and the rings are empty.
+    std::thread output([&] {
+        hdklogger::trace_thread_name("output");
+        hdklogger::drain_channels(channels);
+    });
+
+    auto anyRunning = [&] {
+        for (auto const &channel : channels) {
+            if (channel->reader().running()) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    /// The capture threads only check their stop flags (and their own report
+    /// counts): this thread watches the clock and signals.
+    using clock = std::chrono::steady_clock;
+    auto const timed = opts.duration >= 0;
+    auto const endTime =
+        clock::now() + std::chrono::duration_cast<clock::duration>(
+                           std::chrono::duration<double>(opts.duration));
+    auto const statsInterval = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(opts.statsInterval));
+    auto nextStats = clock::now() + statsInterval;
+    while (anyRunning() && !hdklogger::stop_signal_received()) {
+        auto now = clock::now();
+        if (timed && now >= endTime) {
+            break;
+        }
+        if (opts.statsInterval > 0 && now >= nextStats) {
+            print_stats(channels, std::cerr);
+            nextStats += statsInterval;
+        } else if (hdklogger::stats_signal_received()) {
+            print_stats(channels, std::cerr);
+        }
+        if (hdklogger::trace_signal_received()) {
+            write_trace(opts);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for (auto &channel : channels) {
+        channel->reader().stop();
+    }
+    output.join();
+
+    print_stats(channels, std::cerr);
+
+    int ret = 0;
+    for (auto &channel : channels) {
+        /// Handle error
+        if (channel->reader().had_error()) {
+            fprintf(stderr,
+                    "HIDAPI had an error reading from the HDK %s: %ls\n",
+                    channel->label().c_str(), channel->reader().get_error());
+            ret = -1;
+        }
+        if (!channel->sink().finish()) {
+            std::cerr << "Error writing output for " << channel->label()
+                      << "!" << std::endl;
+            ret = -1;
+        }
+    }
+    write_trace(opts);
+    return ret;
+}
+
+/// @name Sink factories
+/// @brief Create the requested output for one device.
+/// @{
+static void make_sink(std::unique_ptr<hdklogger::BinaryWriter> &sink,
+                      hdklogger::Options const &opts, std::string const &path,
+                      hdklogger::DeviceInfo const &info,
+                      hdklogger::ClockAnchor const &anchor, bool) {
+    auto header = hdklogger::binary::make_header(info);
+    header.anchor = anchor;
+    sink.reset(new hdklogger::BinaryWriter{path, header, opts.writeSettings});
+    auto policy = sink->file().policy();
+    if (policy != opts.writeSettings.sync) {
+        std::cerr << "Can't use --sync=" << to_string(opts.writeSettings.sync)
+                  << " for " << path << ": using " << to_string(policy)
+                  << " instead" << std::endl;
+    }
+}
+static void make_sink(std::unique_ptr<hdklogger::CompressedWriter> &sink,
+                      hdklogger::Options const &opts, std::string const &path,
+                      hdklogger::DeviceInfo const &info,
+                      hdklogger::ClockAnchor const &anchor, bool) {
+    auto header = hdklogger::binary::make_header(info);
+    header.anchor = anchor;
+    sink.reset(new hdklogger::CompressedWriter{path, header, opts.codec});
+}
+static void make_sink(std::unique_ptr<hdklogger::NullWriter> &sink,
+                      hdklogger::Options const &, std::string const &,
+                      hdklogger::DeviceInfo const &,
+                      hdklogger::ClockAnchor const &, bool) {
+    sink.reset(new hdklogger::NullWriter);
+}
+static void make_sink(std::unique_ptr<hdklogger::TextWriter> &sink,
+                      hdklogger::Options const &opts, std::string const &path,
+                      hdklogger::DeviceInfo const &info,
+                      hdklogger::ClockAnchor const &anchor, bool label) {
+    sink.reset(new hdklogger::TextWriter{
+        path, anchor,
+        label ? (info.serialNumber.empty() ? info.path : info.serialNumber)
+              : std::string{}});
+    sink->set_decode(opts.decode);
+}
+/// @}
+
+/// Sets up the given kind of output for each device and captures into it,
+/// returning the process exit code.
+template <typename Sink, typename Device>
+static int run(hdklogger::Options const &opts,
+               std::vector<hdklogger::DeviceInfo> const &infos,
+               std::vector<Device> &devs) {
+    using Channel = hdklogger::CaptureChannel<Device, Sink>;
+    std::vector<std::unique_ptr<Channel>> channels;
+    auto n = infos.size();
+    try {
+        for (std::size_t i = 0; i < n; ++i) {
+            auto path = output_path(opts.output, infos[i], i, n);
+            std::unique_ptr<Sink> sink;
+            /// The default, or an overload found by argument-dependent
+            /// lookup.
+            using hdklogger::clock_anchor;
+            /// Devices sharing stdout need their lines labelled.
+            make_sink(sink, opts, path, infos[i], clock_anchor(devs[i]),
+                      n > 1 && (path.empty() || path == "-"));
+            channels.emplace_back(
+                new Channel{infos[i], std::move(devs[i]), std::move(sink)});
+        }
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    return capture(opts, channels);
+}
+
+/// @overload
+/// Picks the output format from the options.
+template <typename Device>
+static int run(hdklogger::Options const &opts,
+               std::vector<hdklogger::DeviceInfo> const &infos,
+               std::vector<Device> &devs) {
+    if (opts.format == hdklogger::OutputFormat::Binary) {
+        return run<hdklogger::BinaryWriter>(opts, infos, devs);
+    }
+    if (opts.format == hdklogger::OutputFormat::Compressed) {
+        return run<hdklogger::CompressedWriter>(opts, infos, devs);
+    }
+    if (opts.format == hdklogger::OutputFormat::None) {
+        return run<hdklogger::NullWriter>(opts, infos, devs);
+    }
+    return run<hdklogger::TextWriter>(opts, infos, devs);
+}
+
+/// Chooses which of the HDK trackers found to capture from, according to the
+/// options. Returns false (having said why) if a requested one is missing.
+static bool select_devices(hdklogger::Options const &opts,
+                           std::vector<hdklogger::DeviceInfo> &hdks) {
+    if (opts.serials.empty() && opts.paths.empty()) {
+        if (!opts.all && hdks.size() > 1) {
+            /// By default, just the last one found.
+            hdks.erase(hdks.begin(), hdks.end() - 1);
+        }
+        return true;
+    }
+    std::vector<hdklogger::DeviceInfo> selected;
+    bool ok = true;
+    auto select = [&](std::vector<std::string> const &wanted,
+                      std::string hdklogger::DeviceInfo::*field) {
+        for (auto const &want : wanted) {
+            auto it = std::find_if(hdks.begin(), hdks.end(),
+                                   [&](hdklogger::DeviceInfo const &info) {
+                                       return info.*field == want;
+                                   });
+            if (it == hdks.end()) {
+                std::cerr << "Could not find an (unused) HDK tracker " << want
+                          << std::endl;
+                ok = false;
+            } else if (std::find_if(selected.begin(), selected.end(),
+                                    [&](hdklogger::DeviceInfo const &info) {
+                                        return info.path == it->path;
+                                    }) == selected.end()) {
+                selected.push_back(*it);
+            }
+        }
+    };
+    select(opts.serials, &hdklogger::DeviceInfo::serialNumber);
+    select(opts.paths, &hdklogger::DeviceInfo::path);
+    hdks.swap(selected);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    hdklogger::Options opts;
+    if (!hdklogger::parse_options(argc, argv, opts)) {
+        return -1;
+    }
+
+    hdklogger::install_stop_signal_handlers();
+    hdklogger::install_stats_signal_handler();
+    if (!opts.trace.empty()) {
+        hdklogger::install_trace_signal_handler();
+        hdklogger::Tracer::instance().enable(opts.traceEvents);
+        hdklogger::trace_thread_name("main");
+    }
+
+    if (opts.backend == hdklogger::Backend::Simulated) {
+        auto infos = std::vector<hdklogger::DeviceInfo>{};
+        auto devs = std::vector<hdklogger::SimulatedDevice>{};
+        for (std::size_t i = 0; i < opts.simulatedDevices; ++i) {
+            auto info = hdklogger::DeviceInfo{};
+            info.path = "simulated:" + std::to_string(i);
+            info.vendorId = hdklogger::HDK_VID;
+            info.productId = hdklogger::HDK_PID;
+            info.serialNumber = "SIM" + std::to_string(i);
+            infos.push_back(info);
+            /// Different seeds, so devices don't drop in lockstep.
+            auto settings = opts.simulation;
+            settings.seed += i;
+            devs.emplace_back(settings);
+        }
+        return run(opts, infos, devs);
+    }
+
+    if (opts.backend == hdklogger::Backend::Replay) {
+        auto infos = std::vector<hdklogger::DeviceInfo>{};
+        auto devs = std::vector<hdklogger::ReplayDevice>{};
+        try {
+            for (auto const &path : opts.replays) {
+                devs.emplace_back(path, opts.replaySpeed);
+                auto &dev = devs.back();
+                if (opts.replayFrom > 0) {
+                    dev.seek(dev.start_timestamp() +
+                             std::int64_t(opts.replayFrom * 1e9));
+                }
+                infos.push_back(devs.back().info());
+            }
+        } catch (std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return -1;
+        }
+        return run(opts, infos, devs);
+    }
 
-int main() {
     hidapi::Library lib;
-    auto hdk_path = std::string{};
+    auto hdks = std::vector<hdklogger::DeviceInfo>{};
     for (auto cur_dev : hidapi::Enumeration()) {
         printf("Device Found\n  type: %04hx %04hx\n  path: %s\n  "
                "serial_number: %ls",
@@ -47,45 +538,62 @@ int main() {
         printf("  Release:      %hx\n", cur_dev->release_number);
         printf("  Interface:    %d\n", cur_dev->interface_number);
         printf("\n");
-        if (cur_dev->vendor_id == 0x1532 && cur_dev->product_id == 0x0b00) {
+        if (hdklogger::is_hdk(cur_dev->vendor_id, cur_dev->product_id)) {
             printf("  *** This is an HDK tracker! ***\n");
-            hdk_path.assign(cur_dev->path);
+            hdks.emplace_back(*cur_dev);
         }
     }
-    if (hdk_path.empty()) {
+    if (hdks.empty()) {
         std::cerr
             << "Could not find an (unused) HDK tracker! Press enter to exit."
             << std::endl;
         std::cin.ignore();
         return -1;
     }
+    if (!select_devices(opts, hdks)) {
+        return -1;
+    }
 
-    std::cout << "Opening " << hdk_path << std::endl;
-
-    /// Open the device
-    auto dev = hidapi::UniqueDevice{hdk_path};
+#ifdef HDKLOGGER_HAVE_HIDRAW
+    if (opts.backend == hdklogger::Backend::Hidraw) {
+        /// All or nothing, since every device is read the same way.
+        auto nodes = std::vector<std::string>{};
+        for (auto const &hdk : hdks) {
+            nodes.push_back(hdklogger::find_hidraw_node(hdk));
+            if (nodes.back().empty()) {
+                std::cerr << "Could not find the hidraw device node for "
+                          << hdk.path << ": reading through HIDAPI instead"
+                          << std::endl;
+                nodes.clear();
+                break;
+            }
+        }
+        if (!nodes.empty()) {
+            auto devs = std::vector<hdklogger::HidrawDevice>{};
+            for (auto const &node : nodes) {
+                std::cout << "Opening " << node << " (hidraw)" << std::endl;
+                devs.emplace_back(node);
+                if (!devs.back()) {
+                    fprintf(stderr, "Could not open %s: %ls\n",
+                            node.c_str(), devs.back().last_error());
+                    return -1;
+                }
+            }
+            return run(opts, hdks, devs);
+        }
+    }
+#endif
 
-    /// Enable blocking mode on this device
-    hid_set_nonblocking(dev.get(), 0);
+    auto devs = std::vector<hidapi::UniqueDevice>{};
+    for (auto const &hdk : hdks) {
+        std::cout << "Opening " << hdk.path << std::endl;
 
-    using clock = std::chrono::system_clock;
-    // Set end time for the loop shortly into the future.
-    auto endTime = clock::now() + std::chrono::milliseconds(500);
-    while (clock::now() < endTime) {
-        /// Read some data using the non-throwing interface
-        auto result = dev.read();
-        /// Handle error
-        if (hidapi::had_error(result)) {
-            fprintf(stderr, "HIDAPI had an error reading from the HDK: %ls\n",
-                    hidapi::get_error(result));
+        /// Open the device
+        devs.emplace_back(hdk.path);
+        if (!devs.back()) {
+            std::cerr << "Could not open " << hdk.path << std::endl;
             return -1;
         }
-        /// Get the actual data and do something with it.
-        auto const &data = hidapi::get_data(result);
-        std::cout << "Report size: " << data.size()
-                  << " Version number: " << int(data[0])
-                  << " Sequence number: " << int(data[1]) << "\n";
     }
-
-    return 0;
+    return run(opts, hdks, devs);
 }
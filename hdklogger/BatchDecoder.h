@@ -0,0 +1,312 @@
+/** @file
+    @brief Header with a batch decoder turning blocks of raw HDK tracker
+   reports into structure-of-arrays floats, with SIMD kernels.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_BatchDecoder_h_GUID_9CE81FD1_9F48_4D15_8BD5_6FF0E4EB8ECC
+#define INCLUDED_BatchDecoder_h_GUID_9CE81FD1_9F48_4D15_8BD5_6FF0E4EB8ECC
+
+// Internal Includes
+#include "BinaryFormat.h"
+#include "Decoder.h"
+#include "HDK.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <cstddef> // for std::size_t
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+    defined(_M_IX86)
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDKLOGGER_HAVE_SSE2_DECODER
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define HDKLOGGER_HAVE_AVX2_DECODER
+/// Lets a single function use AVX2 without building everything for it.
+#define HDKLOGGER_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#define HDKLOGGER_HAVE_AVX2_DECODER
+#define HDKLOGGER_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+namespace hdklogger {
+/// Bytes of each report the batch decoder reads: everything up to the end of
+/// the angular velocity.
+static const std::size_t BATCH_DECODE_REPORT_BYTES = HDK_VELOCITY_REPORT_LENGTH;
+
+/// Where decode_records() writes its results: one array of at least as many
+/// floats as there are reports for each field.
+struct SampleColumns {
+    float *w;
+    float *x;
+    float *y;
+    float *z;
+    /// Incremental rotation (see Sample), zero for reports before version 2.
+    float *vx;
+    float *vy;
+    float *vz;
+};
+
+/// Implementations of decode_records(), all giving bit-identical results.
+enum class DecodeKernel { Scalar, SSE2, AVX2 };
+
+inline const char *to_string(DecodeKernel kernel) {
+    switch (kernel) {
+    case DecodeKernel::SSE2:
+        return "sse2";
+    case DecodeKernel::AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+/// Can this build, on this CPU, use the given kernel?
+inline bool kernel_supported(DecodeKernel kernel) {
+    switch (kernel) {
+    case DecodeKernel::Scalar:
+        return true;
+    case DecodeKernel::SSE2:
+#ifdef HDKLOGGER_HAVE_SSE2_DECODER
+        return true;
+#else
+        return false;
+#endif
+    case DecodeKernel::AVX2:
+#if defined(HDKLOGGER_HAVE_AVX2_DECODER) && defined(_MSC_VER)
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        return avx2 && osxsave && (_xgetbv(0) & 6) == 6;
+    }
+#elif defined(HDKLOGGER_HAVE_AVX2_DECODER)
+        return __builtin_cpu_supports("avx2") != 0;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+/// The fastest kernel usable here, worked out once.
+inline DecodeKernel best_decode_kernel() {
+    static const DecodeKernel best =
+        kernel_supported(DecodeKernel::AVX2)
+            ? DecodeKernel::AVX2
+            : (kernel_supported(DecodeKernel::SSE2) ? DecodeKernel::SSE2
+                                                    : DecodeKernel::Scalar);
+    return best;
+}
+
+namespace detail {
+    /// Decodes reports [begin, end) one at a time, as decode() does.
+    inline void decode_batch_scalar(std::uint8_t const *reports,
+                                    std::size_t stride, std::size_t begin,
+                                    std::size_t end, SampleColumns const &out) {
+        for (std::size_t n = begin; n < end; ++n) {
+            ReportView report{reports + n * stride, BATCH_DECODE_REPORT_BYTES};
+            out.x[n] = report.raw_quaternion(0) * HDK_QUATERNION_SCALE;
+            out.y[n] = report.raw_quaternion(1) * HDK_QUATERNION_SCALE;
+            out.z[n] = report.raw_quaternion(2) * HDK_QUATERNION_SCALE;
+            out.w[n] = report.raw_quaternion(3) * HDK_QUATERNION_SCALE;
+            out.vx[n] = report.raw_velocity(0) * HDK_VELOCITY_SCALE;
+            out.vy[n] = report.raw_velocity(1) * HDK_VELOCITY_SCALE;
+            out.vz[n] = report.raw_velocity(2) * HDK_VELOCITY_SCALE;
+        }
+    }
+
+    /// Zeroes the angular velocity of records whose reports don't carry
+    /// one.
+    inline void mask_velocity(std::uint8_t const *records, std::size_t count,
+                              SampleColumns const &out) {
+        for (std::size_t n = 0; n < count; ++n) {
+            auto record = records + n * binary::RECORD_SIZE;
+            ReportView report{binary::record_data(record),
+                              binary::record_length(record)};
+            if (!report.has_angular_velocity()) {
+                out.vx[n] = out.vy[n] = out.vz[n] = 0;
+            }
+        }
+    }
+
+#ifdef HDKLOGGER_HAVE_SSE2_DECODER
+    /// Decodes four reports at a time. Loading a report's first 16 bytes
+    /// gives eight int16 lanes: the version and sequence bytes, then the
+    /// seven fixed-point fields. These are widened, scaled, and transposed
+    /// into columns.
+    inline std::size_t decode_batch_sse2(std::uint8_t const *reports,
+                                         std::size_t stride, std::size_t count,
+                                         SampleColumns const &out) {
+        const __m128 loScale =
+            _mm_setr_ps(0.f, HDK_QUATERNION_SCALE, HDK_QUATERNION_SCALE,
+                        HDK_QUATERNION_SCALE);
+        const __m128 hiScale =
+            _mm_setr_ps(HDK_QUATERNION_SCALE, HDK_VELOCITY_SCALE,
+                        HDK_VELOCITY_SCALE, HDK_VELOCITY_SCALE);
+        std::size_t n = 0;
+        for (; n + 4 <= count; n += 4) {
+            __m128 lo[4];
+            __m128 hi[4];
+            for (int r = 0; r < 4; ++r) {
+                __m128i raw = _mm_loadu_si128(reinterpret_cast<__m128i const *>(
+                    reports + (n + r) * stride));
+                /// Sign-extend int16 to int32: [header, i, j, k], [real, x,
+                /// y, z].
+                __m128i l = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+                __m128i h = _mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16);
+                lo[r] = _mm_mul_ps(_mm_cvtepi32_ps(l), loScale);
+                hi[r] = _mm_mul_ps(_mm_cvtepi32_ps(h), hiScale);
+            }
+            _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+            _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+            _mm_storeu_ps(out.x + n, lo[1]);
+            _mm_storeu_ps(out.y + n, lo[2]);
+            _mm_storeu_ps(out.z + n, lo[3]);
+            _mm_storeu_ps(out.w + n, hi[0]);
+            _mm_storeu_ps(out.vx + n, hi[1]);
+            _mm_storeu_ps(out.vy + n, hi[2]);
+            _mm_storeu_ps(out.vz + n, hi[3]);
+        }
+        return n;
+    }
+#endif
+
+#ifdef HDKLOGGER_HAVE_AVX2_DECODER
+    /// Transposes four rows of [a, b, c, d] in each 128-bit half, in place.
+    HDKLOGGER_TARGET_AVX2 inline void transpose4_avx(__m256 &r0, __m256 &r1,
+                                                     __m256 &r2, __m256 &r3) {
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+        __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+        r0 = _mm256_castpd_ps(
+            _mm256_unpacklo_pd(_mm256_castps_pd(t0), _mm256_castps_pd(t2)));
+        r1 = _mm256_castpd_ps(
+            _mm256_unpackhi_pd(_mm256_castps_pd(t0), _mm256_castps_pd(t2)));
+        r2 = _mm256_castpd_ps(
+            _mm256_unpacklo_pd(_mm256_castps_pd(t1), _mm256_castps_pd(t3)));
+        r3 = _mm256_castpd_ps(
+            _mm256_unpackhi_pd(_mm256_castps_pd(t1), _mm256_castps_pd(t3)));
+    }
+
+    /// Decodes eight reports at a time, as the SSE2 kernel does four: report
+    /// r goes in the low half of a register and report r + 4 in the high
+    /// half, so transposing each half leaves the columns in order.
+    HDKLOGGER_TARGET_AVX2 inline std::size_t
+    decode_batch_avx2(std::uint8_t const *reports, std::size_t stride,
+                      std::size_t count, SampleColumns const &out) {
+        const __m256 loScale = _mm256_setr_ps(
+            0.f, HDK_QUATERNION_SCALE, HDK_QUATERNION_SCALE,
+            HDK_QUATERNION_SCALE, 0.f, HDK_QUATERNION_SCALE,
+            HDK_QUATERNION_SCALE, HDK_QUATERNION_SCALE);
+        const __m256 hiScale = _mm256_setr_ps(
+            HDK_QUATERNION_SCALE, HDK_VELOCITY_SCALE, HDK_VELOCITY_SCALE,
+            HDK_VELOCITY_SCALE, HDK_QUATERNION_SCALE, HDK_VELOCITY_SCALE,
+            HDK_VELOCITY_SCALE, HDK_VELOCITY_SCALE);
+        std::size_t n = 0;
+        for (; n + 8 <= count; n += 8) {
+            __m256 lo[4];
+            __m256 hi[4];
+            for (int r = 0; r < 4; ++r) {
+                __m128i first = _mm_loadu_si128(
+                    reinterpret_cast<__m128i const *>(
+                        reports + (n + r) * stride));
+                __m128i second = _mm_loadu_si128(
+                    reinterpret_cast<__m128i const *>(
+                        reports + (n + r + 4) * stride));
+                __m256i raw = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(first), second, 1);
+                __m256i l =
+                    _mm256_srai_epi32(_mm256_unpacklo_epi16(raw, raw), 16);
+                __m256i h =
+                    _mm256_srai_epi32(_mm256_unpackhi_epi16(raw, raw), 16);
+                lo[r] = _mm256_mul_ps(_mm256_cvtepi32_ps(l), loScale);
+                hi[r] = _mm256_mul_ps(_mm256_cvtepi32_ps(h), hiScale);
+            }
+            transpose4_avx(lo[0], lo[1], lo[2], lo[3]);
+            transpose4_avx(hi[0], hi[1], hi[2], hi[3]);
+            _mm256_storeu_ps(out.x + n, lo[1]);
+            _mm256_storeu_ps(out.y + n, lo[2]);
+            _mm256_storeu_ps(out.z + n, lo[3]);
+            _mm256_storeu_ps(out.w + n, hi[0]);
+            _mm256_storeu_ps(out.vx + n, hi[1]);
+            _mm256_storeu_ps(out.vy + n, hi[2]);
+            _mm256_storeu_ps(out.vz + n, hi[3]);
+        }
+        return n;
+    }
+#endif
+} // namespace detail
+
+/// Decodes @p count consecutive records of a binary capture file into
+/// columns of floats: the same values decode_record() puts in a Sample, bit
+/// for bit, whichever kernel is used. The kernel must be supported (see
+/// kernel_supported()).
+///
+/// Records whose reports decode_record() would reject (too short for an
+/// orientation, or version 0) are decoded all the same, so check them if
+/// that matters.
+inline void decode_records(std::uint8_t const *records, std::size_t count,
+                           SampleColumns const &out,
+                           DecodeKernel kernel = best_decode_kernel()) {
+    /// The kernels work on the reports, which are zero-padded in records.
+    auto reports = binary::record_data(records);
+    auto const stride = binary::RECORD_SIZE;
+    std::size_t done = 0;
+    switch (kernel) {
+#ifdef HDKLOGGER_HAVE_AVX2_DECODER
+    case DecodeKernel::AVX2:
+        done = detail::decode_batch_avx2(reports, stride, count, out);
+        break;
+#endif
+#ifdef HDKLOGGER_HAVE_SSE2_DECODER
+    case DecodeKernel::SSE2:
+        done = detail::decode_batch_sse2(reports, stride, count, out);
+        break;
+#endif
+    default:
+        break;
+    }
+    /// Whatever is left over for the vector kernels.
+    detail::decode_batch_scalar(reports, stride, done, count, out);
+    detail::mask_velocity(records, count, out);
+}
+} // namespace hdklogger
+
+#endif // INCLUDED_BatchDecoder_h_GUID_9CE81FD1_9F48_4D15_8BD5_6FF0E4EB8ECC
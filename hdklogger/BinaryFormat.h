@@ -0,0 +1,329 @@
+/** @file
+    @brief Header describing the compact binary capture file format.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_BinaryFormat_h_GUID_EC052D21_624B_42DA_9B51_23ECC52335B8
+#define INCLUDED_BinaryFormat_h_GUID_EC052D21_624B_42DA_9B51_23ECC52335B8
+
+// Internal Includes
+#include "Clock.h"
+#include "DeviceInfo.h"
+#include "HDK.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <algorithm>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace hdklogger {
+/// @brief The binary capture format.
+///
+/// A file is a fixed-size header followed by fixed-size records, and
+/// optionally a time index, all little-endian.
+///
+/// Header (HEADER_SIZE bytes):
+/// - 0: magic (8 bytes, `MAGIC`)
+/// - 8: format version (u16)
+/// - 10: header size (u16)
+/// - 12: record size (u16)
+/// - 14: vendor ID (u16)
+/// - 16: product ID (u16)
+/// - 18: release number (u16)
+/// - 20: clock domain of record timestamps (u8, ClockDomain)
+/// - 21-23: reserved, zero
+/// - 24: clock anchor: monotonic time (i64, ns)
+/// - 32: clock anchor: simultaneous wall-clock time (i64, ns since the Unix
+///   epoch), or 0 if unknown
+/// - 40: offset of the time index (u64), or 0 if there is none (format
+///   version 1, or a capture that was never finished)
+/// - 48-63: reserved, zero
+/// - 64: serial number (ASCII, NUL-padded, SERIAL_LENGTH bytes)
+///
+/// Record (RECORD_SIZE bytes):
+/// - 0: timestamp, in nanoseconds of the header's clock domain (i64)
+/// - 8: report length (u16)
+/// - 10-15: reserved, zero
+/// - 16: raw report bytes (RECORD_DATA_LENGTH bytes, zero-padded)
+///
+/// Records run up to the time index if there is one, or else to the end of
+/// the file (ignoring any truncated final record).
+///
+/// Time index (at the offset in the header), a sparse map from timestamps to
+/// records, with an entry for every `interval`-th record:
+/// - 0: magic (8 bytes, `INDEX_MAGIC`)
+/// - 8: interval (u32)
+/// - 12-15: reserved, zero
+/// - 16: number of entries (u64)
+/// - 24: entries (INDEX_ENTRY_SIZE bytes each): timestamp of the record
+///   (i64), then its number (u64), in order
+namespace binary {
+    static const char MAGIC[8] = {'H', 'D', 'K', 'L', 'O', 'G', '\x1a', '\n'};
+    static const std::uint16_t FORMAT_VERSION = 2;
+    static const std::size_t HEADER_SIZE = 128;
+    static const std::size_t SERIAL_OFFSET = 64;
+    static const std::size_t SERIAL_LENGTH = HEADER_SIZE - SERIAL_OFFSET;
+    static const std::size_t RECORD_SIZE = 48;
+    static const std::size_t RECORD_DATA_OFFSET = 16;
+    static const std::size_t RECORD_DATA_LENGTH =
+        RECORD_SIZE - RECORD_DATA_OFFSET;
+    static_assert(RECORD_DATA_LENGTH >= HDK_MAX_REPORT_LENGTH,
+                  "Records must be able to hold a whole HDK report.");
+    static const std::size_t INDEX_OFFSET_OFFSET = 40;
+    static const char INDEX_MAGIC[8] = {'H', 'D', 'K', 'I',
+                                        'D', 'X', '\x1a', '\n'};
+    static const std::size_t INDEX_HEADER_SIZE = 24;
+    static const std::size_t INDEX_ENTRY_SIZE = 16;
+    /// Records per index entry, unless told otherwise: an entry per 48 KiB
+    /// of records.
+    static const std::uint32_t DEFAULT_INDEX_INTERVAL = 1024;
+
+    /// @name Little-endian field access
+    /// @{
+    inline void store_u16(std::uint8_t *dest, std::uint16_t val) {
+        dest[0] = std::uint8_t(val);
+        dest[1] = std::uint8_t(val >> 8);
+    }
+    inline void store_u32(std::uint8_t *dest, std::uint32_t val) {
+        for (int i = 0; i < 4; ++i) {
+            dest[i] = std::uint8_t(val >> (8 * i));
+        }
+    }
+    inline void store_u64(std::uint8_t *dest, std::uint64_t val) {
+        for (int i = 0; i < 8; ++i) {
+            dest[i] = std::uint8_t(val >> (8 * i));
+        }
+    }
+    inline std::uint16_t load_u16(std::uint8_t const *src) {
+        return std::uint16_t(src[0] | (src[1] << 8));
+    }
+    inline std::uint32_t load_u32(std::uint8_t const *src) {
+        return std::uint32_t(src[0]) | (std::uint32_t(src[1]) << 8) |
+               (std::uint32_t(src[2]) << 16) | (std::uint32_t(src[3]) << 24);
+    }
+    inline std::uint64_t load_u64(std::uint8_t const *src) {
+        std::uint64_t ret = 0;
+        for (int i = 7; i >= 0; --i) {
+            ret = (ret << 8) | src[i];
+        }
+        return ret;
+    }
+    /// @}
+
+    /// Contents of a capture file header.
+    struct Header {
+        std::uint16_t formatVersion = FORMAT_VERSION;
+        std::uint16_t vendorId = 0;
+        std::uint16_t productId = 0;
+        std::uint16_t releaseNumber = 0;
+        ClockDomain clockDomain = MONOTONIC_CLOCK_DOMAIN;
+        /// Relates record timestamps to wall-clock time.
+        ClockAnchor anchor;
+        /// Where the time index starts, or 0 if there is none. Filled in by
+        /// BinaryWriter when it finishes.
+        std::uint64_t indexOffset = 0;
+        std::string serialNumber;
+    };
+
+    /// Fills in a header describing a device.
+    inline Header make_header(DeviceInfo const &info) {
+        Header ret;
+        ret.vendorId = info.vendorId;
+        ret.productId = info.productId;
+        ret.releaseNumber = info.releaseNumber;
+        ret.serialNumber = info.serialNumber;
+        ret.anchor = make_clock_anchor();
+        return ret;
+    }
+
+    /// Serializes a header into HEADER_SIZE bytes at @p dest. Other file
+    /// types sharing the header layout pass their own @p magic.
+    inline void encode_header(Header const &header, std::uint8_t *dest,
+                              const char (&magic)[8] = MAGIC) {
+        std::memset(dest, 0, HEADER_SIZE);
+        std::memcpy(dest, magic, sizeof(magic));
+        store_u16(dest + 8, header.formatVersion);
+        store_u16(dest + 10, HEADER_SIZE);
+        store_u16(dest + 12, RECORD_SIZE);
+        store_u16(dest + 14, header.vendorId);
+        store_u16(dest + 16, header.productId);
+        store_u16(dest + 18, header.releaseNumber);
+        dest[20] = std::uint8_t(header.clockDomain);
+        store_u64(dest + 24, std::uint64_t(header.anchor.monotonic));
+        store_u64(dest + 32, std::uint64_t(header.anchor.wallClock));
+        store_u64(dest + INDEX_OFFSET_OFFSET, header.indexOffset);
+        std::memcpy(dest + SERIAL_OFFSET, header.serialNumber.data(),
+                    std::min(header.serialNumber.size(), SERIAL_LENGTH - 1));
+    }
+
+    /// Parses a header from the start of a capture file, returning false if
+    /// it isn't one we can read.
+    inline bool decode_header(std::uint8_t const *src, std::size_t len,
+                              Header &header,
+                              const char (&magic)[8] = MAGIC) {
+        if (len < HEADER_SIZE || 0 != std::memcmp(src, magic, sizeof(magic)) ||
+            load_u16(src + 10) != HEADER_SIZE ||
+            load_u16(src + 12) != RECORD_SIZE) {
+            return false;
+        }
+        header.formatVersion = load_u16(src + 8);
+        if (header.formatVersion > FORMAT_VERSION) {
+            return false;
+        }
+        header.vendorId = load_u16(src + 14);
+        header.productId = load_u16(src + 16);
+        header.releaseNumber = load_u16(src + 18);
+        header.clockDomain = ClockDomain(src[20]);
+        header.anchor.monotonic = std::int64_t(load_u64(src + 24));
+        header.anchor.wallClock = std::int64_t(load_u64(src + 32));
+        /// Reserved, so zero, in version 1.
+        header.indexOffset = load_u64(src + INDEX_OFFSET_OFFSET);
+        auto serial = reinterpret_cast<char const *>(src + SERIAL_OFFSET);
+        header.serialNumber.assign(serial,
+                                   std::find(serial, serial + SERIAL_LENGTH,
+                                             '\0'));
+        return true;
+    }
+
+    /// Serializes a record into RECORD_SIZE bytes at @p dest.
+    inline void encode_record(std::int64_t timestamp,
+                              std::uint8_t const *report, std::size_t length,
+                              std::uint8_t *dest) {
+        length = std::min(length, RECORD_DATA_LENGTH);
+        store_u64(dest, std::uint64_t(timestamp));
+        store_u16(dest + 8, std::uint16_t(length));
+        std::memset(dest + 10, 0, RECORD_SIZE - 10);
+        std::memcpy(dest + RECORD_DATA_OFFSET, report, length);
+    }
+
+    /// Where the records of a file of @p fileSize bytes with this header end.
+    inline std::uint64_t records_end(Header const &header,
+                                     std::uint64_t fileSize) {
+        auto end = header.indexOffset ? std::min(header.indexOffset, fileSize)
+                                      : fileSize;
+        return end < HEADER_SIZE ? HEADER_SIZE : end;
+    }
+
+    /// @name Record field access
+    /// @{
+    inline std::int64_t record_timestamp(std::uint8_t const *record) {
+        return std::int64_t(load_u64(record));
+    }
+    inline std::size_t record_length(std::uint8_t const *record) {
+        return std::min(std::size_t(load_u16(record + 8)),
+                        RECORD_DATA_LENGTH);
+    }
+    inline std::uint8_t const *record_data(std::uint8_t const *record) {
+        return record + RECORD_DATA_OFFSET;
+    }
+    /// @}
+
+    /// An entry of the time index.
+    struct IndexEntry {
+        std::int64_t timestamp;
+        std::uint64_t record;
+    };
+
+    /// @name Time index encoding
+    /// @{
+    inline void encode_index_header(std::uint32_t interval,
+                                    std::uint64_t entries,
+                                    std::uint8_t *dest) {
+        std::memset(dest, 0, INDEX_HEADER_SIZE);
+        std::memcpy(dest, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        store_u32(dest + 8, interval);
+        store_u64(dest + 16, entries);
+    }
+    /// Parses an index header from @p len bytes, returning false if they
+    /// don't hold one, or not all of its entries.
+    inline bool decode_index_header(std::uint8_t const *src, std::size_t len,
+                                    std::uint32_t &interval,
+                                    std::uint64_t &entries) {
+        if (len < INDEX_HEADER_SIZE ||
+            0 != std::memcmp(src, INDEX_MAGIC, sizeof(INDEX_MAGIC))) {
+            return false;
+        }
+        interval = load_u32(src + 8);
+        entries = load_u64(src + 16);
+        return interval != 0 &&
+               entries <= (len - INDEX_HEADER_SIZE) / INDEX_ENTRY_SIZE;
+    }
+    inline void encode_index_entry(IndexEntry const &entry,
+                                   std::uint8_t *dest) {
+        store_u64(dest, std::uint64_t(entry.timestamp));
+        store_u64(dest + 8, entry.record);
+    }
+    inline IndexEntry decode_index_entry(std::uint8_t const *src) {
+        return IndexEntry{std::int64_t(load_u64(src)), load_u64(src + 8)};
+    }
+    /// @}
+
+    /// Finds the first of @p records records with a timestamp of at least
+    /// @p timestamp (or @p records if there is none), by binary search: over
+    /// the @p entries index entries first, if any, then over the records
+    /// between two entries. @p recordTimestamp(i) gives the timestamp of
+    /// record i, and @p indexEntry(k) index entry k, so they can be read in
+    /// place or from a file as needed.
+    template <typename RecordTimestamp, typename IndexEntryAt>
+    inline std::uint64_t find_record(std::int64_t timestamp,
+                                     std::uint64_t records,
+                                     RecordTimestamp recordTimestamp,
+                                     std::uint64_t entries,
+                                     IndexEntryAt indexEntry) {
+        std::uint64_t lo = 0;
+        std::uint64_t hi = records;
+        /// First index entry at or after the timestamp.
+        std::uint64_t first = 0;
+        std::uint64_t last = entries;
+        while (first < last) {
+            auto mid = first + (last - first) / 2;
+            if (indexEntry(mid).timestamp < timestamp) {
+                first = mid + 1;
+            } else {
+                last = mid;
+            }
+        }
+        if (first < entries) {
+            hi = std::min(hi, indexEntry(first).record);
+        }
+        if (first > 0) {
+            lo = std::min(hi, indexEntry(first - 1).record + 1);
+        }
+        while (lo < hi) {
+            auto mid = lo + (hi - lo) / 2;
+            if (recordTimestamp(mid) < timestamp) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+} // namespace binary
+} // namespace hdklogger
+
+#endif // INCLUDED_BinaryFormat_h_GUID_EC052D21_624B_42DA_9B51_23ECC52335B8
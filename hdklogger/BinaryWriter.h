@@ -0,0 +1,135 @@
+/** @file
+    @brief Header defining the writer for the binary capture format.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_BinaryWriter_h_GUID_3850932D_4D50_4F5F_AC29_D57ADD1136A9
+#define INCLUDED_BinaryWriter_h_GUID_3850932D_4D50_4F5F_AC29_D57ADD1136A9
+
+// Internal Includes
+#include "BinaryFormat.h"
+#include "Capture.h"
+#include "GroupCommitFile.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hdklogger {
+/// Writes captured reports to a file in the binary capture format, coalescing
+/// records into large writes, and ending it with a time index.
+class BinaryWriter {
+  public:
+    /// Constructor: creates the file and writes the header. @p settings say
+    /// when buffered records are written out, and how durably. The time index
+    /// gets an entry every @p indexInterval records: 0 leaves it out. It is
+    /// also left out if the file can't be seeked back to, to record where the
+    /// index is in the header. Throws std::runtime_error if the file cannot
+    /// be created.
+    BinaryWriter(std::string const &path, binary::Header const &header,
+                 GroupCommitSettings const &settings = GroupCommitSettings{},
+                 std::uint32_t indexInterval = binary::DEFAULT_INDEX_INTERVAL)
+        : file_(path, settings), indexInterval_(indexInterval) {
+        if (!file_.seekable()) {
+            /// A pipe or the like.
+            indexInterval_ = 0;
+        }
+        auto start = header;
+        start.indexOffset = 0;
+        binary::encode_header(start, file_.reserve(binary::HEADER_SIZE));
+        file_.commit(binary::HEADER_SIZE);
+    }
+
+    ~BinaryWriter() { finish(); }
+
+    BinaryWriter(BinaryWriter const &) = delete;
+    BinaryWriter &operator=(BinaryWriter const &) = delete;
+
+    /// Appends a record for a captured report.
+    void write(CapturedReport const &captured) {
+        binary::encode_record(captured.timestamp, captured.report.data(),
+                              captured.report.size(),
+                              file_.reserve(binary::RECORD_SIZE));
+        file_.commit(binary::RECORD_SIZE);
+        if (indexInterval_ && records_ % indexInterval_ == 0) {
+            index_.push_back(
+                binary::IndexEntry{captured.timestamp, records_});
+        }
+        ++records_;
+    }
+
+    /// Writes out buffered records if they have waited long enough.
+    void poll() { file_.poll(); }
+
+    /// Writes out anything buffered and the time index, and closes the
+    /// file. Returns false if any write failed.
+    bool finish() {
+        if (file_.open()) {
+            if (indexInterval_) {
+                write_index_();
+            }
+            file_.close();
+        }
+        return file_.ok();
+    }
+
+    /// Have all writes so far succeeded?
+    bool ok() const { return file_.ok(); }
+
+    /// The file written to, for its write statistics.
+    GroupCommitFile const &file() const { return file_; }
+
+  private:
+    /// Appends the index, then points the header at it: a capture cut short
+    /// before this has no index, rather than one that is incomplete.
+    void write_index_() {
+        auto offset = file_.size();
+        binary::encode_index_header(indexInterval_, index_.size(),
+                                    file_.reserve(binary::INDEX_HEADER_SIZE));
+        file_.commit(binary::INDEX_HEADER_SIZE);
+        for (auto const &entry : index_) {
+            binary::encode_index_entry(
+                entry, file_.reserve(binary::INDEX_ENTRY_SIZE));
+            file_.commit(binary::INDEX_ENTRY_SIZE);
+        }
+        std::uint8_t field[8];
+        binary::store_u64(field, offset);
+        file_.patch(binary::INDEX_OFFSET_OFFSET, field, sizeof(field));
+    }
+
+    GroupCommitFile file_;
+    std::uint32_t indexInterval_;
+    std::uint64_t records_ = 0;
+    std::vector<binary::IndexEntry> index_;
+};
+
+/// Gives the writer the chance to write out records that have waited long
+/// enough: see poll_sink() in Capture.h.
+inline void poll_sink(BinaryWriter &writer) { writer.poll(); }
+} // namespace hdklogger
+
+#endif // INCLUDED_BinaryWriter_h_GUID_3850932D_4D50_4F5F_AC29_D57ADD1136A9
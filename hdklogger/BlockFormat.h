@@ -0,0 +1,237 @@
+/** @file
+    @brief Header describing the block-compressed capture format.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_BlockFormat_h_GUID_F1BCAE0F_8D3D_41BA_8813_6D64F1F966D1
+#define INCLUDED_BlockFormat_h_GUID_F1BCAE0F_8D3D_41BA_8813_6D64F1F966D1
+
+// Internal Includes
+#include "BinaryFormat.h"
+#include "Capture.h"
+#include "Compression.h"
+#include "HDK.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <algorithm>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace hdklogger {
+/// @brief The block-compressed capture format.
+///
+/// Records are grouped into independently compressed blocks, so blocks can
+/// be decompressed in parallel and skipped over without being decompressed.
+/// All little-endian.
+///
+/// File header: as binary::Header (HEADER_SIZE bytes), with `MAGIC` and
+/// its own format version. The index offset field points at the block
+/// index, if any.
+///
+/// Block (BLOCK_HEADER_SIZE bytes, then the compressed payload):
+/// - 0: block magic (4 bytes, `BLOCK_MAGIC`), to find blocks again in a
+///   damaged file
+/// - 4: codec (u8, Codec)
+/// - 5-7: reserved, zero
+/// - 8: number of records (u32)
+/// - 12: payload size uncompressed (u32)
+/// - 16: payload size compressed (u32)
+/// - 20-23: reserved, zero
+/// - 24: timestamp of the first record (i64)
+/// - 32: timestamp of the last record (i64)
+/// - 40: number of the first record in the file (u64)
+///
+/// Payload, uncompressed, for n records, column by column, each a plane of n
+/// bytes: splitting fields up byte by byte puts similar bytes together,
+/// which compresses far better than whole records.
+/// - 8 planes: bytes 0-7 of each timestamp's difference from the one
+///   before (the first record's is from itself, so 0), zigzag-encoded
+/// - 1 plane: report lengths
+/// - RECORD_DATA_LENGTH planes: report bytes 0, 1... zero-padded, except
+///   that byte 1 (the sequence number) is stored as the difference from the
+///   one before
+///
+/// Block index (at the offset in the file header):
+/// - 0: magic (8 bytes, `INDEX_MAGIC`)
+/// - 8: number of entries (u64)
+/// - 16: entries (INDEX_ENTRY_SIZE bytes each), one per block in order:
+///   block offset (u64), timestamp of its first record (i64), number of its
+///   first record (u64)
+namespace block {
+    static const char MAGIC[8] = {'H', 'D', 'K', 'B', 'L', 'K', '\x1a', '\n'};
+    static const std::uint16_t FORMAT_VERSION = 1;
+    static const char BLOCK_MAGIC[4] = {'H', 'B', 'L', 'K'};
+    static const std::size_t BLOCK_HEADER_SIZE = 48;
+    static const char INDEX_MAGIC[8] = {'H', 'D', 'K', 'B',
+                                        'I', 'D', 'X', '\n'};
+    static const std::size_t INDEX_HEADER_SIZE = 16;
+    static const std::size_t INDEX_ENTRY_SIZE = 24;
+    /// Records per block unless told otherwise: about 4 s at the HDK's report
+    /// rate, 164 KiB uncompressed.
+    static const std::size_t DEFAULT_BLOCK_RECORDS = 4096;
+    /// Bytes of uncompressed payload per record.
+    static const std::size_t PAYLOAD_BYTES_PER_RECORD =
+        8 + 1 + binary::RECORD_DATA_LENGTH;
+
+    /// Where a block is and what it starts with: all that the block index
+    /// holds.
+    struct BlockLocation {
+        std::uint64_t offset;
+        std::int64_t firstTimestamp;
+        std::uint64_t firstRecord;
+    };
+
+    /// Contents of a block header.
+    struct BlockHeader {
+        Codec codec = Codec::None;
+        std::uint32_t records = 0;
+        std::uint32_t rawSize = 0;
+        std::uint32_t compressedSize = 0;
+        std::int64_t firstTimestamp = 0;
+        std::int64_t lastTimestamp = 0;
+        std::uint64_t firstRecord = 0;
+    };
+
+    inline void encode_block_header(BlockHeader const &header,
+                                    std::uint8_t *dest) {
+        std::memset(dest, 0, BLOCK_HEADER_SIZE);
+        std::memcpy(dest, BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+        dest[4] = std::uint8_t(header.codec);
+        binary::store_u32(dest + 8, header.records);
+        binary::store_u32(dest + 12, header.rawSize);
+        binary::store_u32(dest + 16, header.compressedSize);
+        binary::store_u64(dest + 24, std::uint64_t(header.firstTimestamp));
+        binary::store_u64(dest + 32, std::uint64_t(header.lastTimestamp));
+        binary::store_u64(dest + 40, header.firstRecord);
+    }
+
+    /// Parses a block header, returning false if it isn't one, or is
+    /// inconsistent.
+    inline bool decode_block_header(std::uint8_t const *src,
+                                    BlockHeader &header) {
+        if (0 != std::memcmp(src, BLOCK_MAGIC, sizeof(BLOCK_MAGIC))) {
+            return false;
+        }
+        header.codec = Codec(src[4]);
+        header.records = binary::load_u32(src + 8);
+        header.rawSize = binary::load_u32(src + 12);
+        header.compressedSize = binary::load_u32(src + 16);
+        header.firstTimestamp = std::int64_t(binary::load_u64(src + 24));
+        header.lastTimestamp = std::int64_t(binary::load_u64(src + 32));
+        header.firstRecord = binary::load_u64(src + 40);
+        return header.rawSize ==
+               std::uint64_t(header.records) * PAYLOAD_BYTES_PER_RECORD;
+    }
+
+    inline std::uint64_t zigzag(std::int64_t val) {
+        return (std::uint64_t(val) << 1) ^ std::uint64_t(val >> 63);
+    }
+    inline std::int64_t unzigzag(std::uint64_t val) {
+        return std::int64_t(val >> 1) ^ -std::int64_t(val & 1);
+    }
+
+    /// Delta-encodes and byte-shuffles @p n records into an uncompressed
+    /// payload of n * PAYLOAD_BYTES_PER_RECORD bytes at @p dest.
+    inline void encode_payload(CapturedReport const *records, std::size_t n,
+                               std::uint8_t *dest) {
+        auto lengths = dest + 8 * n;
+        auto planes = lengths + n;
+        std::memset(planes, 0, binary::RECORD_DATA_LENGTH * n);
+        std::int64_t lastTimestamp = n ? records[0].timestamp : 0;
+        std::uint8_t lastSequence = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            auto const &captured = records[i];
+            auto delta = zigzag(captured.timestamp - lastTimestamp);
+            lastTimestamp = captured.timestamp;
+            for (std::size_t b = 0; b < 8; ++b) {
+                dest[b * n + i] = std::uint8_t(delta >> (8 * b));
+            }
+            auto len = std::min(captured.report.size(),
+                                binary::RECORD_DATA_LENGTH);
+            lengths[i] = std::uint8_t(len);
+            for (std::size_t b = 0; b < len; ++b) {
+                planes[b * n + i] = captured.report[b];
+            }
+            auto sequence = planes[HDK_SEQUENCE_OFFSET * n + i];
+            planes[HDK_SEQUENCE_OFFSET * n + i] =
+                std::uint8_t(sequence - lastSequence);
+            lastSequence = sequence;
+        }
+    }
+
+    /// Reverses encode_payload(), given the block's first timestamp.
+    inline void decode_payload(std::uint8_t const *src, std::size_t n,
+                               std::int64_t firstTimestamp,
+                               CapturedReport *records) {
+        auto lengths = src + 8 * n;
+        auto planes = lengths + n;
+        auto timestamp = firstTimestamp;
+        std::uint8_t sequence = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            auto &captured = records[i];
+            std::uint64_t delta = 0;
+            for (std::size_t b = 0; b < 8; ++b) {
+                delta |= std::uint64_t(src[b * n + i]) << (8 * b);
+            }
+            timestamp += unzigzag(delta);
+            captured.timestamp = timestamp;
+            auto len = std::min(std::size_t(lengths[i]),
+                                std::min(binary::RECORD_DATA_LENGTH,
+                                         captured.report.capacity()));
+            captured.report.resize(len);
+            sequence = std::uint8_t(sequence +
+                                    planes[HDK_SEQUENCE_OFFSET * n + i]);
+            for (std::size_t b = 0; b < len; ++b) {
+                captured.report[b] = b == HDK_SEQUENCE_OFFSET
+                                         ? sequence
+                                         : planes[b * n + i];
+            }
+        }
+    }
+
+    /// Decompresses and decodes a block's payload into @p records, which is
+    /// resized to fit. Returns false if the block is corrupt or its codec
+    /// unavailable. Touches nothing shared, so blocks can be decoded in
+    /// parallel.
+    inline bool decode_block(BlockHeader const &header,
+                             std::uint8_t const *payload,
+                             std::vector<std::uint8_t> &scratch,
+                             std::vector<CapturedReport> &records) {
+        scratch.resize(header.rawSize);
+        if (!decompress(header.codec, payload, header.compressedSize,
+                        scratch.data(), scratch.size())) {
+            return false;
+        }
+        records.resize(header.records);
+        decode_payload(scratch.data(), header.records, header.firstTimestamp,
+                       records.data());
+        return true;
+    }
+} // namespace block
+} // namespace hdklogger
+
+#endif // INCLUDED_BlockFormat_h_GUID_F1BCAE0F_8D3D_41BA_8813_6D64F1F966D1
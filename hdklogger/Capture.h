@@ -0,0 +1,378 @@
+/** @file
+    @brief Header defining the capture thread that reads reports from a device.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Capture_h_GUID_58E4E49B_CEE6_4A39_AC25_0363087DB591
+#define INCLUDED_Capture_h_GUID_58E4E49B_CEE6_4A39_AC25_0363087DB591
+
+// Internal Includes
+#include "Clock.h"
+#include "DeviceInfo.h"
+#include "HDK.h"
+#include "Histogram.h"
+#include "SequenceTracker.h"
+#include "SpscRing.h"
+#include "Trace.h"
+
+// Library/third-party includes
+#include "hidapipp/Device.h"
+
+// Standard includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hdklogger {
+/// A raw report as captured, with the time it was read.
+struct CapturedReport {
+    /// Time the read returned, from monotonic_now().
+    std::int64_t timestamp;
+    HDKReport report;
+};
+
+/// Ring buffer carrying captured reports from the capture thread to the
+/// output thread.
+using ReportRing = SpscRing<CapturedReport>;
+
+/// Default number of reports the ring can hold: a few seconds at the HDK's
+/// report rate.
+static const std::size_t DEFAULT_RING_CAPACITY = 4096;
+
+/// How long a single read waits before rechecking whether to stop.
+static const int READ_TIMEOUT_MS = 100;
+
+/// Most reports the capture thread takes from the device in one batch: enough
+/// to absorb the backlog after a scheduling hiccup in a few calls.
+static const std::size_t READ_BATCH_SIZE = 64;
+
+/// @name Capture pipeline customization points
+/// @brief Overload these, in the device type's namespace, for devices whose
+/// reports don't arrive live (see ReplayDevice).
+/// @{
+/// Timestamp for the report @p dev has just returned: by default, now.
+template <typename Device>
+inline std::int64_t report_timestamp(Device const &) {
+    return monotonic_now();
+}
+/// Relates a device's report timestamps to wall-clock time: by default, an
+/// anchor taken now.
+template <typename Device> inline ClockAnchor clock_anchor(Device const &) {
+    return make_clock_anchor();
+}
+/// Whether a failed read just means the device has no more reports, rather
+/// than an error: by default, never.
+template <typename Device> inline bool end_of_stream(Device const &) {
+    return false;
+}
+/// Whether reading can wait for room in the ring when it is full, rather
+/// than reading and dropping reports: by default not, since a live device
+/// would then drop them itself.
+template <typename Device> inline bool can_wait_for_ring(Device const &) {
+    return false;
+}
+/// Nominal time between the device's reports, in nanoseconds, for telling a
+/// long gap in sequence numbers from a late report: by default, the HDK's.
+template <typename Device> inline std::int64_t report_period(Device const &) {
+    return HDK_REPORT_PERIOD_NS;
+}
+/// @}
+
+/// @brief Sink customization point: called on the output thread after each
+/// drain into the sink, whether or not anything was drained, for sinks with
+/// time-based work to do such as writing out buffered output. By default,
+/// nothing. Overload it in the sink type's namespace (see BinaryWriter).
+template <typename Sink> inline void poll_sink(Sink &) {}
+
+/// Reads reports from a device on a dedicated thread, timestamping them and
+/// pushing them into a ReportRing for a consumer thread to drain.
+///
+/// Works with any hidapi::DeviceBase-derived device type.
+template <typename Device> class ReportReader {
+  public:
+    ReportReader(Device &dev, ReportRing &ring) : dev_(dev), ring_(ring) {
+        sequence_.set_period(report_period(dev_));
+    }
+
+    ~ReportReader() { stop(); }
+
+    ReportReader(ReportReader const &) = delete;
+    ReportReader &operator=(ReportReader const &) = delete;
+
+    /// Makes the capture thread stop by itself after this many reports: 0
+    /// (the default) means no limit. Call before start().
+    void set_max_reports(std::uint64_t maxReports) { maxReports_ = maxReports; }
+
+    /// Sets a function for the capture thread to run before it starts
+    /// reading, such as to change its scheduling. Call before start().
+    void set_thread_setup(std::function<void()> setup) {
+        setup_ = std::move(setup);
+    }
+
+    /// Function given each report as soon as it has been read and
+    /// timestamped: see set_publisher().
+    using Publisher = std::function<void(
+        std::int64_t timestamp, hidapi::DataByte const *data, std::size_t)>;
+
+    /// Sets a function for the capture thread to hand each report to before
+    /// queueing it, such as to publish it to other processes without waiting
+    /// on the output thread: even reports the ring has no room for. It must
+    /// never block. Call before start().
+    void set_publisher(Publisher publisher) {
+        publish_ = std::move(publisher);
+    }
+
+    /// Starts the capture thread.
+    void start() {
+        running_ = true;
+        thread_ = std::thread([&] { run_(); });
+    }
+
+    /// Asks the capture thread to stop, and waits for it to do so.
+    void stop() {
+        stopRequested_ = true;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    /// Is the capture thread still reading? It finishes on its own after a
+    /// read error or at the end of the device's stream.
+    bool running() const { return running_; }
+
+    /// @name Results
+    /// @brief Only valid after stop() has returned.
+    /// @{
+    bool had_error() const { return nullptr != error_; }
+    const wchar_t *get_error() const { return error_; }
+    /// @}
+
+    /// Number of reports read from the device, including any dropped because
+    /// the ring was full.
+    std::uint64_t reports() const {
+        return reports_.load(std::memory_order_relaxed);
+    }
+
+    /// Sequence-number statistics, updated live by the capture thread.
+    SequenceTracker const &sequence() const { return sequence_; }
+
+    /// Histogram of the time between consecutive reports, in nanoseconds,
+    /// updated live by the capture thread.
+    Histogram const &inter_arrival() const { return interArrival_; }
+
+  private:
+    void run_() {
+        if (setup_) {
+            setup_();
+        }
+        /// Reports are taken from the device in batches: all those already
+        /// waiting, in one call. Reports that don't fit in the ring are still
+        /// read, to keep the device's buffer drained, then dropped.
+        HDKReportBatch batch{READ_BATCH_SIZE};
+        std::uint64_t remaining = maxReports_;
+        std::int64_t lastTimestamp = 0;
+        auto const wait = can_wait_for_ring(dev_);
+        /// Each report is timestamped as soon as it has been read.
+        auto now = [&] { return report_timestamp(dev_); };
+        while (!stopRequested_.load(std::memory_order_relaxed)) {
+            auto want = batch.capacity();
+            if (wait) {
+                want = std::min(want, ring_.producer_room());
+                if (want == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+            }
+            if (remaining) {
+                want = std::size_t(std::min<std::uint64_t>(want, remaining));
+            }
+            auto result = dev_.read_batch(batch, want, READ_TIMEOUT_MS, now);
+            std::int64_t returned = 0;
+            if (tracing() && !batch.empty()) {
+                returned = monotonic_now();
+                for (std::size_t i = 0; i < batch.size(); ++i) {
+                    trace_instant(TracePoint::Receive, batch.timestamp(i),
+                                  batch.length(i) >= 2 ? batch.data(i)[1]
+                                                       : 0);
+                }
+                trace_instant(TracePoint::Read, returned, batch.size());
+            }
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                auto len = batch.length(i);
+                auto timestamp = batch.timestamp(i);
+                reports_.store(reports_.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+                if (len >= 2) {
+                    sequence_.record(batch.data(i)[1], timestamp);
+                }
+                /// A timestamp that doesn't move forward (from a replayed
+                /// or backend clock) has no meaningful interval.
+                if (lastTimestamp && timestamp > lastTimestamp) {
+                    interArrival_.record(
+                        std::uint64_t(timestamp - lastTimestamp));
+                }
+                lastTimestamp = timestamp;
+                if (publish_) {
+                    publish_(timestamp, batch.data(i), len);
+                }
+                auto slot = ring_.producer_slot();
+                if (slot) {
+                    slot->timestamp = timestamp;
+                    std::memcpy(slot->report.data(), batch.data(i), len);
+                    slot->report.resize(len);
+                    ring_.commit();
+                } else {
+                    ring_.record_overflow();
+                }
+            }
+            if (returned) {
+                trace_span(TracePoint::Enqueue, returned, monotonic_now(),
+                           batch.size());
+            }
+            if (remaining) {
+                remaining -= batch.size();
+                if (remaining == 0) {
+                    break;
+                }
+            }
+            if (hidapi::had_error(result)) {
+                if (!end_of_stream(dev_)) {
+                    error_ = hidapi::get_error(result);
+                }
+                break;
+            }
+        }
+        running_ = false;
+    }
+
+    Device &dev_;
+    ReportRing &ring_;
+    std::thread thread_;
+    std::atomic<bool> stopRequested_{false};
+    std::atomic<bool> running_{false};
+    std::atomic<std::uint64_t> reports_{0};
+    std::uint64_t maxReports_ = 0;
+    std::function<void()> setup_;
+    Publisher publish_;
+    SequenceTracker sequence_;
+    Histogram interArrival_;
+    const wchar_t *error_ = nullptr;
+};
+
+/// Largest number of reports moved from one ring to its sink before moving
+/// on to the next device's ring.
+static const std::size_t MAX_DRAIN_BATCH = 256;
+
+/// Everything needed to capture from one device: the device itself, its
+/// capture thread, the ring carrying its reports, and the sink (any type with
+/// `write(CapturedReport const &)` and `finish()` methods) they end up in.
+///
+/// Not movable, since the capture thread refers to its members: keep it in a
+/// std::unique_ptr.
+template <typename Device, typename Sink> class CaptureChannel {
+  public:
+    CaptureChannel(DeviceInfo const &info, Device &&dev,
+                   std::unique_ptr<Sink> &&sink,
+                   std::size_t ringCapacity = DEFAULT_RING_CAPACITY)
+        : info_(info), dev_(std::move(dev)), ring_(ringCapacity),
+          reader_(dev_, ring_), sink_(std::move(sink)) {}
+
+    CaptureChannel(CaptureChannel const &) = delete;
+    CaptureChannel &operator=(CaptureChannel const &) = delete;
+
+    DeviceInfo const &info() const { return info_; }
+    /// Short name for the device in messages: its serial number, if it has
+    /// one, or else its path.
+    std::string const &label() const {
+        return info_.serialNumber.empty() ? info_.path : info_.serialNumber;
+    }
+    Device &device() { return dev_; }
+    ReportRing &ring() { return ring_; }
+    ReportRing const &ring() const { return ring_; }
+    ReportReader<Device> &reader() { return reader_; }
+    ReportReader<Device> const &reader() const { return reader_; }
+    Sink &sink() { return *sink_; }
+    Sink const &sink() const { return *sink_; }
+
+    /// Moves up to @p maxReports waiting reports into the sink, returning how
+    /// many were moved. Call from the output thread only.
+    std::size_t drain(std::size_t maxReports = MAX_DRAIN_BATCH) {
+        auto start = tracing() ? monotonic_now() : 0;
+        std::size_t n = 0;
+        for (; n < maxReports; ++n) {
+            auto captured = ring_.front();
+            if (!captured) {
+                break;
+            }
+            sink_->write(*captured);
+            ring_.pop();
+        }
+        if (start && n) {
+            trace_span(TracePoint::Dequeue, start, monotonic_now(), n);
+        }
+        poll_sink(*sink_);
+        return n;
+    }
+
+  private:
+    DeviceInfo info_;
+    Device dev_;
+    ReportRing ring_;
+    ReportReader<Device> reader_;
+    std::unique_ptr<Sink> sink_;
+};
+
+/// Drains captured reports from every channel into its sink until all the
+/// readers have stopped and all the rings are empty. Meant to run on its own
+/// thread: one such thread serves any number of devices.
+template <typename Channel>
+inline void drain_channels(std::vector<std::unique_ptr<Channel>> &channels) {
+    for (;;) {
+        /// Check before draining: if every reader had stopped and there was
+        /// then nothing to drain, nothing more can arrive.
+        bool anyRunning = false;
+        for (auto const &channel : channels) {
+            anyRunning = anyRunning || channel->reader().running();
+        }
+        std::size_t moved = 0;
+        for (auto &channel : channels) {
+            moved += channel->drain();
+        }
+        if (moved == 0) {
+            if (!anyRunning) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+} // namespace hdklogger
+
+#endif // INCLUDED_Capture_h_GUID_58E4E49B_CEE6_4A39_AC25_0363087DB591
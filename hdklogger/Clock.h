@@ -0,0 +1,107 @@
+/** @file
+    @brief Header defining the monotonic clock used to timestamp reports.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Clock_h_GUID_3D7C318F_4E0E_4839_8BFC_188B7B5C75E6
+#define INCLUDED_Clock_h_GUID_3D7C318F_4E0E_4839_8BFC_188B7B5C75E6
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <chrono>
+#include <cstdint>
+
+#ifdef __linux__
+#include <time.h>
+#endif
+
+namespace hdklogger {
+/// Clocks that report timestamps may be measured against.
+enum class ClockDomain : std::uint8_t {
+    /// std::chrono::steady_clock
+    SteadyClock = 0,
+    /// Linux CLOCK_MONOTONIC_RAW: not slewed by NTP.
+    MonotonicRaw = 1
+};
+
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_RAW)
+/// The clock domain monotonic_now() measures.
+static const ClockDomain MONOTONIC_CLOCK_DOMAIN = ClockDomain::MonotonicRaw;
+
+/// Reads the monotonic clock used for report timestamps, in nanoseconds.
+inline std::int64_t monotonic_now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return std::int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+#else
+/// The clock domain monotonic_now() measures.
+static const ClockDomain MONOTONIC_CLOCK_DOMAIN = ClockDomain::SteadyClock;
+
+/// Reads the monotonic clock used for report timestamps, in nanoseconds.
+inline std::int64_t monotonic_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+#endif
+
+/// Reads the wall clock, in nanoseconds since the Unix epoch.
+inline std::int64_t wall_clock_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/// A simultaneous reading of the monotonic and wall clocks, for converting
+/// monotonic timestamps to wall-clock time:
+/// `wall = wallClock + (timestamp - monotonic)`.
+struct ClockAnchor {
+    std::int64_t monotonic = 0;
+    std::int64_t wallClock = 0;
+};
+
+/// Takes a clock anchor, bracketing the wall clock reading between two
+/// monotonic readings and keeping the tightest of a few tries.
+inline ClockAnchor make_clock_anchor() {
+    ClockAnchor ret;
+    std::int64_t bestGap = -1;
+    for (int i = 0; i < 5; ++i) {
+        auto before = monotonic_now();
+        auto wall = wall_clock_now();
+        auto after = monotonic_now();
+        if (bestGap < 0 || after - before < bestGap) {
+            bestGap = after - before;
+            ret.monotonic = before + (after - before) / 2;
+            ret.wallClock = wall;
+        }
+    }
+    return ret;
+}
+} // namespace hdklogger
+
+#endif // INCLUDED_Clock_h_GUID_3D7C318F_4E0E_4839_8BFC_188B7B5C75E6
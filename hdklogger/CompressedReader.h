@@ -0,0 +1,221 @@
+/** @file
+    @brief Header defining a reader of block-compressed captures.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_CompressedReader_h_GUID_87CFD991_78DB_4545_9326_C3CB62070D65
+#define INCLUDED_CompressedReader_h_GUID_87CFD991_78DB_4545_9326_C3CB62070D65
+
+// Internal Includes
+#include "BinaryFormat.h"
+#include "BlockFormat.h"
+#include "Capture.h"
+#include "FileOffset.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <algorithm>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace hdklogger {
+/// Reads block-compressed captures (see block) a block at a time.
+///
+/// Blocks are found from the block index, or, for a capture that was cut
+/// short and so has none, by walking the block headers up to the first
+/// incomplete block. find_block() then seeks by time in O(log n) without
+/// decompressing anything. read_block() reads and decodes a block. For
+/// parallel decompression, read payloads with read_payload() on one thread
+/// and pass them to block::decode_block() on others.
+class CompressedReader {
+  public:
+    /// Constructor: opens a capture and locates its blocks. Throws
+    /// std::runtime_error if it cannot be opened or is not a block-compressed
+    /// capture.
+    explicit CompressedReader(std::string const &path)
+        : file_(std::fopen(path.c_str(), "rb")) {
+        if (!file_) {
+            throw std::runtime_error("Could not open capture file " + path);
+        }
+        std::uint8_t buf[binary::HEADER_SIZE];
+        if (std::fread(buf, 1, sizeof(buf), file_.get()) != sizeof(buf) ||
+            !binary::decode_header(buf, sizeof(buf), header_, block::MAGIC)) {
+            throw std::runtime_error(path +
+                                     " is not a block-compressed capture");
+        }
+        if (!(header_.indexOffset && read_index_())) {
+            scan_blocks_();
+        }
+    }
+
+    CompressedReader(CompressedReader const &) = delete;
+    CompressedReader &operator=(CompressedReader const &) = delete;
+
+    binary::Header const &header() const { return header_; }
+
+    /// Number of blocks.
+    std::size_t size() const { return blocks_.size(); }
+    block::BlockLocation const &location(std::size_t i) const {
+        return blocks_[i];
+    }
+
+    /// Is there a block index, or was the capture cut short?
+    bool indexed() const { return indexed_; }
+
+    /// Number of records in all blocks.
+    std::uint64_t records() const { return records_; }
+
+    /// Finds the block holding the first record with a timestamp of at least
+    /// @p timestamp: the last block starting no later than that (or the
+    /// first block, if none does). Its records may still all be earlier, in
+    /// which case the next block starts with the record sought.
+    std::size_t find_block(std::int64_t timestamp) const {
+        auto it = std::upper_bound(
+            blocks_.begin(), blocks_.end(), timestamp,
+            [](std::int64_t t, block::BlockLocation const &loc) {
+                return t < loc.firstTimestamp;
+            });
+        return it == blocks_.begin() ? 0
+                                     : std::size_t(it - blocks_.begin()) - 1;
+    }
+
+    /// Reads block @p i's header and compressed payload. Returns false if it
+    /// can't be read or is damaged.
+    bool read_payload(std::size_t i, block::BlockHeader &header,
+                      std::vector<std::uint8_t> &payload) {
+        std::uint8_t buf[block::BLOCK_HEADER_SIZE];
+        if (i >= blocks_.size() ||
+            !file_seek(file_.get(), blocks_[i].offset) ||
+            std::fread(buf, 1, sizeof(buf), file_.get()) != sizeof(buf) ||
+            !block::decode_block_header(buf, header)) {
+            return false;
+        }
+        payload.resize(header.compressedSize);
+        return std::fread(payload.data(), 1, payload.size(), file_.get()) ==
+               payload.size();
+    }
+
+    /// Reads and decodes block @p i into @p records (resized to fit).
+    /// Returns false if it can't be read or is damaged.
+    bool read_block(std::size_t i, std::vector<CapturedReport> &records) {
+        block::BlockHeader header;
+        return read_payload(i, header, payload_) &&
+               block::decode_block(header, payload_.data(), scratch_,
+                                   records);
+    }
+
+  private:
+    bool read_index_() {
+        auto size = file_size(file_.get());
+        std::uint8_t buf[block::INDEX_HEADER_SIZE];
+        if (size < 0 || header_.indexOffset > std::uint64_t(size) ||
+            !file_seek(file_.get(), header_.indexOffset) ||
+            std::fread(buf, 1, sizeof(buf), file_.get()) != sizeof(buf) ||
+            0 != std::memcmp(buf, block::INDEX_MAGIC,
+                             sizeof(block::INDEX_MAGIC))) {
+            return false;
+        }
+        /// A damaged count must not become a huge allocation: the entries
+        /// have to fit in the file.
+        auto entries = binary::load_u64(buf + 8);
+        auto room = std::uint64_t(size) - header_.indexOffset;
+        if (room < block::INDEX_HEADER_SIZE ||
+            entries > (room - block::INDEX_HEADER_SIZE) /
+                          block::INDEX_ENTRY_SIZE) {
+            return false;
+        }
+        std::vector<std::uint8_t> raw(
+            std::size_t(entries * block::INDEX_ENTRY_SIZE));
+        if (std::fread(raw.data(), 1, raw.size(), file_.get()) != raw.size()) {
+            return false;
+        }
+        blocks_.resize(std::size_t(entries));
+        for (std::size_t k = 0; k < blocks_.size(); ++k) {
+            auto src = raw.data() + k * block::INDEX_ENTRY_SIZE;
+            blocks_[k].offset = binary::load_u64(src);
+            blocks_[k].firstTimestamp = std::int64_t(binary::load_u64(src + 8));
+            blocks_[k].firstRecord = binary::load_u64(src + 16);
+        }
+        records_ = 0;
+        if (!blocks_.empty()) {
+            /// The last block's header gives the total.
+            block::BlockHeader last;
+            if (!read_payload(blocks_.size() - 1, last, payload_)) {
+                blocks_.clear();
+                return false;
+            }
+            records_ = last.firstRecord + last.records;
+        }
+        indexed_ = true;
+        return true;
+    }
+
+    /// Walks the block headers from the start, keeping the complete blocks.
+    void scan_blocks_() {
+        blocks_.clear();
+        records_ = 0;
+        std::uint64_t offset = binary::HEADER_SIZE;
+        for (;;) {
+            std::uint8_t buf[block::BLOCK_HEADER_SIZE];
+            block::BlockHeader header;
+            if (!file_seek(file_.get(), offset) ||
+                std::fread(buf, 1, sizeof(buf), file_.get()) != sizeof(buf) ||
+                !block::decode_block_header(buf, header)) {
+                return;
+            }
+            auto next = offset + block::BLOCK_HEADER_SIZE +
+                        header.compressedSize;
+            /// Incomplete if the file ends before its payload does.
+            if (header.compressedSize &&
+                (!file_seek(file_.get(), next - 1) ||
+                 std::fgetc(file_.get()) == EOF)) {
+                return;
+            }
+            blocks_.push_back(block::BlockLocation{
+                offset, header.firstTimestamp, header.firstRecord});
+            records_ = header.firstRecord + header.records;
+            offset = next;
+        }
+    }
+
+    struct FileCloser {
+        void operator()(std::FILE *f) { std::fclose(f); }
+    };
+    std::unique_ptr<std::FILE, FileCloser> file_;
+    binary::Header header_;
+    std::vector<block::BlockLocation> blocks_;
+    std::uint64_t records_ = 0;
+    bool indexed_ = false;
+    std::vector<std::uint8_t> payload_;
+    std::vector<std::uint8_t> scratch_;
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_CompressedReader_h_GUID_87CFD991_78DB_4545_9326_C3CB62070D65
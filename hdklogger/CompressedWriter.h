@@ -0,0 +1,304 @@
+/** @file
+    @brief Header defining a writer of block-compressed captures, compressing
+   on a background thread.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_CompressedWriter_h_GUID_EC4D0E8C_E545_44DB_BC7C_6682A1EB5EED
+#define INCLUDED_CompressedWriter_h_GUID_EC4D0E8C_E545_44DB_BC7C_6682A1EB5EED
+
+// Internal Includes
+#include "BinaryFormat.h"
+#include "BlockFormat.h"
+#include "Capture.h"
+#include "Compression.h"
+#include "FileOffset.h"
+#include "Trace.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <condition_variable>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hdklogger {
+/// Writes captured reports to a file in the block-compressed capture format
+/// (see block). Reports are gathered into blocks by the calling (output)
+/// thread. A background thread then compresses and writes them, so neither
+/// compression nor disk I/O holds up the caller. Should the compressor fall
+/// behind by more than a few blocks, write() waits for it: the capture ring
+/// then absorbs the delay.
+class CompressedWriter {
+  public:
+    /// Blocks that can be waiting for the compressor, beyond the one being
+    /// filled.
+    static const std::size_t BLOCKS_IN_FLIGHT = 3;
+
+    /// Constructor: creates the file, writes the header, and starts the
+    /// compressor thread. Throws std::runtime_error if the file cannot be
+    /// created or the codec is unavailable.
+    CompressedWriter(std::string const &path, binary::Header const &header,
+                     Codec codec = default_codec(),
+                     std::size_t blockRecords = block::DEFAULT_BLOCK_RECORDS)
+        : file_(open_(path, codec)), codec_(codec),
+          blockRecords_(std::max(blockRecords, std::size_t(1))) {
+        if (!file_) {
+            throw std::runtime_error("Could not create capture file " + path);
+        }
+        seekable_ = file_tell(file_.get()) >= 0;
+        auto start = header;
+        start.formatVersion = block::FORMAT_VERSION;
+        start.indexOffset = 0;
+        std::uint8_t buf[binary::HEADER_SIZE];
+        binary::encode_header(start, buf, block::MAGIC);
+        write_(buf, sizeof(buf));
+        for (std::size_t i = 0; i < BLOCKS_IN_FLIGHT + 1; ++i) {
+            free_.emplace_back(new Block(blockRecords_));
+        }
+        current_ = take_free_();
+        compressor_ = std::thread([&] { compress_loop_(); });
+    }
+
+    ~CompressedWriter() { finish(); }
+
+    CompressedWriter(CompressedWriter const &) = delete;
+    CompressedWriter &operator=(CompressedWriter const &) = delete;
+
+    /// Adds a captured report to the current block, handing the block to the
+    /// compressor once full.
+    void write(CapturedReport const &captured) {
+        current_->records[current_->count++] = captured;
+        if (current_->count == blockRecords_) {
+            submit_();
+        }
+    }
+
+    /// Compresses and writes everything so far, then the block index, and
+    /// closes the file. Returns false if anything failed.
+    bool finish() {
+        if (!file_) {
+            return ok_;
+        }
+        if (current_->count) {
+            submit_();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        cv_.notify_all();
+        compressor_.join();
+        if (seekable_) {
+            write_index_();
+        }
+        if (0 != std::fclose(file_.release())) {
+            ok_ = false;
+        }
+        return ok_;
+    }
+
+    /// @name Results
+    /// @brief Only valid after finish() has returned.
+    /// @{
+    /// Did all writes succeed?
+    bool ok() const { return ok_; }
+    std::uint64_t records() const { return records_; }
+    /// Size the records would have had in the uncompressed binary format.
+    std::uint64_t bytes_in() const {
+        return binary::HEADER_SIZE + records_ * binary::RECORD_SIZE;
+    }
+    /// Size of the file written.
+    std::uint64_t bytes_out() const { return offset_; }
+    /// @}
+
+  private:
+    /// Opens the capture file, having first checked the codec, so asking
+    /// for an unavailable one leaves any existing file untouched.
+    static std::FILE *open_(std::string const &path, Codec codec) {
+        if (!codec_available(codec)) {
+            throw std::runtime_error(std::string("Compression codec ") +
+                                     to_string(codec) +
+                                     " is not available in this build");
+        }
+        return std::fopen(path.c_str(), "wb");
+    }
+
+    struct Block {
+        explicit Block(std::size_t capacity)
+            : records(new CapturedReport[capacity]) {}
+        std::unique_ptr<CapturedReport[]> records;
+        std::size_t count = 0;
+    };
+    using BlockPtr = std::unique_ptr<Block>;
+
+    /// Hands the current block to the compressor, and gets an empty one,
+    /// waiting if none is free.
+    void submit_() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            full_.push_back(std::move(current_));
+        }
+        cv_.notify_all();
+        current_ = take_free_();
+    }
+
+    BlockPtr take_free_() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&] { return !free_.empty(); });
+        auto ret = std::move(free_.back());
+        free_.pop_back();
+        return ret;
+    }
+
+    void compress_loop_() {
+        trace_thread_name("compressor");
+        std::vector<std::uint8_t> raw;
+        std::vector<std::uint8_t> compressed;
+        for (;;) {
+            BlockPtr blk;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] { return done_ || !full_.empty(); });
+                if (full_.empty()) {
+                    return;
+                }
+                blk = std::move(full_.front());
+                full_.pop_front();
+            }
+            write_block_(*blk, raw, compressed);
+            blk->count = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                free_.push_back(std::move(blk));
+            }
+            cv_.notify_all();
+        }
+    }
+
+    /// Compressor thread only, or after it has finished.
+    void write_block_(Block const &blk, std::vector<std::uint8_t> &raw,
+                      std::vector<std::uint8_t> &compressed) {
+        block::BlockHeader header;
+        header.records = std::uint32_t(blk.count);
+        header.rawSize =
+            std::uint32_t(blk.count * block::PAYLOAD_BYTES_PER_RECORD);
+        header.firstTimestamp = blk.records[0].timestamp;
+        header.lastTimestamp = blk.records[blk.count - 1].timestamp;
+        header.firstRecord = records_;
+        {
+            TraceScope trace(TracePoint::Compress, blk.count);
+            raw.resize(header.rawSize);
+            block::encode_payload(blk.records.get(), blk.count, raw.data());
+            header.codec = codec_;
+            if (!compress(codec_, raw.data(), raw.size(), compressed) ||
+                compressed.size() >= raw.size()) {
+                /// Store it as-is rather than make it bigger.
+                header.codec = Codec::None;
+                compressed.swap(raw);
+            }
+        }
+        header.compressedSize = std::uint32_t(compressed.size());
+        index_.push_back(block::BlockLocation{
+            offset_, header.firstTimestamp, header.firstRecord});
+        std::uint8_t buf[block::BLOCK_HEADER_SIZE];
+        block::encode_block_header(header, buf);
+        TraceScope trace(TracePoint::Write,
+                         sizeof(buf) + compressed.size());
+        write_(buf, sizeof(buf));
+        write_(compressed.data(), compressed.size());
+        records_ += blk.count;
+    }
+
+    /// Appends the block index and points the header at it.
+    void write_index_() {
+        auto offset = offset_;
+        std::vector<std::uint8_t> buf(block::INDEX_HEADER_SIZE +
+                                      index_.size() * block::INDEX_ENTRY_SIZE);
+        std::memcpy(buf.data(), block::INDEX_MAGIC,
+                    sizeof(block::INDEX_MAGIC));
+        binary::store_u64(buf.data() + 8, index_.size());
+        auto entry = buf.data() + block::INDEX_HEADER_SIZE;
+        for (auto const &loc : index_) {
+            binary::store_u64(entry, loc.offset);
+            binary::store_u64(entry + 8, std::uint64_t(loc.firstTimestamp));
+            binary::store_u64(entry + 16, loc.firstRecord);
+            entry += block::INDEX_ENTRY_SIZE;
+        }
+        write_(buf.data(), buf.size());
+        std::uint8_t field[8];
+        binary::store_u64(field, offset);
+        if (!ok_ ||
+            !file_seek(file_.get(),
+                       std::uint64_t(binary::INDEX_OFFSET_OFFSET)) ||
+            std::fwrite(field, 1, sizeof(field), file_.get()) !=
+                sizeof(field)) {
+            ok_ = false;
+        }
+    }
+
+    void write_(void const *data, std::size_t len) {
+        if (ok_ && std::fwrite(data, 1, len, file_.get()) != len) {
+            ok_ = false;
+        }
+        offset_ += len;
+    }
+
+    struct FileCloser {
+        void operator()(std::FILE *f) { std::fclose(f); }
+    };
+    std::unique_ptr<std::FILE, FileCloser> file_;
+    Codec codec_;
+    std::size_t blockRecords_;
+    bool seekable_ = true;
+    /// Only touched by the caller's thread.
+    BlockPtr current_;
+    /// @name Shared with the compressor thread, under mutex_
+    /// @{
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<BlockPtr> free_;
+    std::deque<BlockPtr> full_;
+    bool done_ = false;
+    /// @}
+    /// Only touched by the compressor thread while it runs.
+    /// @{
+    std::uint64_t offset_ = 0;
+    std::uint64_t records_ = 0;
+    std::vector<block::BlockLocation> index_;
+    bool ok_ = true;
+    /// @}
+    std::thread compressor_;
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_CompressedWriter_h_GUID_EC4D0E8C_E545_44DB_BC7C_6682A1EB5EED
@@ -0,0 +1,196 @@
+/** @file
+    @brief Header wrapping the general-purpose compressors usable for
+   block-compressed captures.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Compression_h_GUID_05F265A9_1801_459F_9CC0_31DD5B875BAB
+#define INCLUDED_Compression_h_GUID_05F265A9_1801_459F_9CC0_31DD5B875BAB
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+#ifdef HDKLOGGER_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef HDKLOGGER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HDKLOGGER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Standard includes
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace hdklogger {
+/// Compressors a block can be stored with. Which are available depends on the
+/// libraries found at build time (HDKLOGGER_HAVE_LZ4 and so on), except for
+/// None, which is always available.
+enum class Codec : std::uint8_t { None = 0, LZ4 = 1, Zstd = 2, Deflate = 3 };
+
+/// zstd level used: fast enough to keep up with several trackers on one
+/// core.
+static const int ZSTD_LEVEL = 1;
+
+inline const char *to_string(Codec codec) {
+    switch (codec) {
+    case Codec::LZ4:
+        return "lz4";
+    case Codec::Zstd:
+        return "zstd";
+    case Codec::Deflate:
+        return "deflate";
+    default:
+        return "none";
+    }
+}
+
+/// Parses a codec name, as given by to_string(). Returns false if unknown.
+inline bool parse_codec(std::string const &name, Codec &codec) {
+    for (auto c : {Codec::None, Codec::LZ4, Codec::Zstd, Codec::Deflate}) {
+        if (name == to_string(c)) {
+            codec = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Was this build made with the given codec?
+inline bool codec_available(Codec codec) {
+    switch (codec) {
+    case Codec::None:
+        return true;
+#ifdef HDKLOGGER_HAVE_LZ4
+    case Codec::LZ4:
+        return true;
+#endif
+#ifdef HDKLOGGER_HAVE_ZSTD
+    case Codec::Zstd:
+        return true;
+#endif
+#ifdef HDKLOGGER_HAVE_ZLIB
+    case Codec::Deflate:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+/// The fastest codec available: LZ4, then zstd, then deflate.
+inline Codec default_codec() {
+    for (auto c : {Codec::LZ4, Codec::Zstd, Codec::Deflate}) {
+        if (codec_available(c)) {
+            return c;
+        }
+    }
+    return Codec::None;
+}
+
+/// Compresses @p len bytes into @p dest, which is resized to fit. Returns
+/// false if the codec is unavailable or fails.
+inline bool compress(Codec codec, std::uint8_t const *src, std::size_t len,
+                     std::vector<std::uint8_t> &dest) {
+    switch (codec) {
+    case Codec::None:
+        dest.assign(src, src + len);
+        return true;
+#ifdef HDKLOGGER_HAVE_LZ4
+    case Codec::LZ4: {
+        dest.resize(std::size_t(LZ4_compressBound(int(len))));
+        auto n = LZ4_compress_default(reinterpret_cast<const char *>(src),
+                                      reinterpret_cast<char *>(dest.data()),
+                                      int(len), int(dest.size()));
+        dest.resize(n > 0 ? std::size_t(n) : 0);
+        return n > 0;
+    }
+#endif
+#ifdef HDKLOGGER_HAVE_ZSTD
+    case Codec::Zstd: {
+        dest.resize(ZSTD_compressBound(len));
+        auto n = ZSTD_compress(dest.data(), dest.size(), src, len, ZSTD_LEVEL);
+        if (ZSTD_isError(n)) {
+            dest.clear();
+            return false;
+        }
+        dest.resize(n);
+        return true;
+    }
+#endif
+#ifdef HDKLOGGER_HAVE_ZLIB
+    case Codec::Deflate: {
+        auto n = compressBound(uLong(len));
+        dest.resize(n);
+        auto ok = Z_OK == compress2(dest.data(), &n, src, uLong(len),
+                                    Z_BEST_SPEED);
+        dest.resize(ok ? std::size_t(n) : 0);
+        return ok;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+/// Decompresses @p len bytes into exactly @p destLen bytes at @p dest.
+/// Returns false if the codec is unavailable, or the data is corrupt or
+/// not of that size.
+inline bool decompress(Codec codec, std::uint8_t const *src, std::size_t len,
+                       std::uint8_t *dest, std::size_t destLen) {
+    switch (codec) {
+    case Codec::None:
+        if (len != destLen) {
+            return false;
+        }
+        std::memcpy(dest, src, len);
+        return true;
+#ifdef HDKLOGGER_HAVE_LZ4
+    case Codec::LZ4:
+        return LZ4_decompress_safe(reinterpret_cast<const char *>(src),
+                                   reinterpret_cast<char *>(dest), int(len),
+                                   int(destLen)) == int(destLen);
+#endif
+#ifdef HDKLOGGER_HAVE_ZSTD
+    case Codec::Zstd:
+        return ZSTD_decompress(dest, destLen, src, len) == destLen;
+#endif
+#ifdef HDKLOGGER_HAVE_ZLIB
+    case Codec::Deflate: {
+        auto n = uLongf(destLen);
+        return Z_OK == uncompress(dest, &n, src, uLong(len)) &&
+               n == uLongf(destLen);
+    }
+#endif
+    default:
+        return false;
+    }
+}
+} // namespace hdklogger
+
+#endif // INCLUDED_Compression_h_GUID_05F265A9_1801_459F_9CC0_31DD5B875BAB
@@ -0,0 +1,207 @@
+/** @file
+    @brief Header with a decoder turning raw HDK tracker reports into typed
+   orientation and angular-velocity samples.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Decoder_h_GUID_C790A6CB_61B7_4B21_A696_D97430E78215
+#define INCLUDED_Decoder_h_GUID_C790A6CB_61B7_4B21_A696_D97430E78215
+
+// Internal Includes
+#include "BinaryFormat.h"
+#include "Capture.h"
+#include "HDK.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <cmath>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+
+namespace hdklogger {
+/// Unit quaternion, as decoded from a report.
+struct Quaternion {
+    float w = 1;
+    float x = 0;
+    float y = 0;
+    float z = 0;
+};
+
+/// Three-component vector.
+struct Vec3 {
+    float x = 0;
+    float y = 0;
+    float z = 0;
+};
+
+/// Scale factors turning the raw fixed-point fields into floats: exact powers
+/// of two, so the conversion loses nothing beyond the float's precision.
+/// @{
+static const float HDK_QUATERNION_SCALE =
+    1.f / float(1 << HDK_QUATERNION_FRACTIONAL_BITS);
+static const float HDK_VELOCITY_SCALE =
+    1.f / float(1 << HDK_VELOCITY_FRACTIONAL_BITS);
+/// @}
+
+/// Read-only view of a raw HDK tracker report, interpreting its fields in
+/// place without copying. The viewed bytes must outlive the view.
+///
+/// Versions 1 (orientation only), 2 and 3 (orientation and angular velocity)
+/// are understood. Later versions are read as version 3, on the assumption
+/// that firmware only appends fields.
+class ReportView {
+  public:
+    ReportView(std::uint8_t const *data, std::size_t length)
+        : data_(data), length_(length) {}
+
+    /// @overload
+    explicit ReportView(HDKReport const &report)
+        : ReportView(report.data(), report.size()) {}
+
+    std::uint8_t const *data() const { return data_; }
+    std::size_t size() const { return length_; }
+
+    /// Report version: the low nibble of the first byte.
+    std::uint8_t version() const {
+        return length_ ? data_[0] & HDK_VERSION_MASK : 0;
+    }
+    /// Status flags in the high nibble of the first byte, on firmware that
+    /// sets them.
+    std::uint8_t flags() const {
+        return length_ ? data_[0] >> 4 : 0;
+    }
+    std::uint8_t sequence() const {
+        return length_ > HDK_SEQUENCE_OFFSET ? data_[HDK_SEQUENCE_OFFSET] : 0;
+    }
+
+    /// Is this long enough, and of a version, to hold an orientation?
+    bool has_orientation() const {
+        return version() != 0 && length_ >= HDK_ORIENTATION_REPORT_LENGTH;
+    }
+    /// Does this also hold an angular velocity?
+    bool has_angular_velocity() const {
+        return version() >= HDK_VELOCITY_MIN_VERSION &&
+               length_ >= HDK_VELOCITY_REPORT_LENGTH;
+    }
+
+    /// @name Raw fixed-point fields
+    /// @brief Only meaningful if the report has the corresponding field.
+    /// @{
+    /// Quaternion component: 0-2 for i, j, k, 3 for the real part.
+    std::int16_t raw_quaternion(std::size_t i) const {
+        return load_i16(data_ + HDK_QUATERNION_OFFSET + 2 * i);
+    }
+    /// Incremental rotation component: 0-2 for x, y, z.
+    std::int16_t raw_velocity(std::size_t i) const {
+        return load_i16(data_ + HDK_VELOCITY_OFFSET + 2 * i);
+    }
+    /// @}
+
+    static std::int16_t load_i16(std::uint8_t const *src) {
+        return std::int16_t(std::uint16_t(src[0] | (src[1] << 8)));
+    }
+
+  private:
+    std::uint8_t const *data_;
+    std::size_t length_;
+};
+
+/// A decoded tracker report.
+struct Sample {
+    /// When the report was read, in nanoseconds of the capture's clock.
+    std::int64_t timestamp = 0;
+    std::uint8_t version = 0;
+    std::uint8_t flags = 0;
+    std::uint8_t sequence = 0;
+    /// Whether incrementalRotation holds data: reports before version 2
+    /// carry no angular velocity.
+    bool hasAngularVelocity = false;
+    Quaternion orientation;
+    /// Vector part of the rotation over HDK_VELOCITY_DT seconds, as reported.
+    Vec3 incrementalRotation;
+
+    /// Angular velocity in radians per second, about the axes of
+    /// incrementalRotation: zero if the report carries none.
+    Vec3 angular_velocity() const {
+        Vec3 ret;
+        auto const &v = incrementalRotation;
+        auto sinHalfAngle = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+        if (!hasAngularVelocity || sinHalfAngle == 0) {
+            return ret;
+        }
+        /// Clamped, since fixed-point rounding can push it just past 1.
+        auto angle = 2 * std::asin(std::fmin(sinHalfAngle, 1.f));
+        auto scale = float(angle / HDK_VELOCITY_DT) / sinHalfAngle;
+        ret.x = v.x * scale;
+        ret.y = v.y * scale;
+        ret.z = v.z * scale;
+        return ret;
+    }
+};
+
+/// Decodes a report into @p sample, returning false (leaving @p sample
+/// untouched) if it holds no orientation: too short, or version 0.
+inline bool decode(ReportView const &report, std::int64_t timestamp,
+                   Sample &sample) {
+    if (!report.has_orientation()) {
+        return false;
+    }
+    sample.timestamp = timestamp;
+    sample.version = report.version();
+    sample.flags = report.flags();
+    sample.sequence = report.sequence();
+    sample.orientation.x = report.raw_quaternion(0) * HDK_QUATERNION_SCALE;
+    sample.orientation.y = report.raw_quaternion(1) * HDK_QUATERNION_SCALE;
+    sample.orientation.z = report.raw_quaternion(2) * HDK_QUATERNION_SCALE;
+    sample.orientation.w = report.raw_quaternion(3) * HDK_QUATERNION_SCALE;
+    sample.hasAngularVelocity = report.has_angular_velocity();
+    if (sample.hasAngularVelocity) {
+        sample.incrementalRotation.x =
+            report.raw_velocity(0) * HDK_VELOCITY_SCALE;
+        sample.incrementalRotation.y =
+            report.raw_velocity(1) * HDK_VELOCITY_SCALE;
+        sample.incrementalRotation.z =
+            report.raw_velocity(2) * HDK_VELOCITY_SCALE;
+    } else {
+        sample.incrementalRotation = Vec3{};
+    }
+    return true;
+}
+
+/// @overload
+/// For a report from the capture pipeline.
+inline bool decode(CapturedReport const &captured, Sample &sample) {
+    return decode(ReportView{captured.report}, captured.timestamp, sample);
+}
+
+/// Decodes a record of a binary capture file (RECORD_SIZE bytes), as
+/// decode() does a report.
+inline bool decode_record(std::uint8_t const *record, Sample &sample) {
+    return decode(ReportView{binary::record_data(record),
+                             binary::record_length(record)},
+                  binary::record_timestamp(record), sample);
+}
+} // namespace hdklogger
+
+#endif // INCLUDED_Decoder_h_GUID_C790A6CB_61B7_4B21_A696_D97430E78215
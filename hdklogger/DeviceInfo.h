@@ -0,0 +1,69 @@
+/** @file
+    @brief Header defining a copy of the enumeration data describing a device.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_DeviceInfo_h_GUID_6E481CDC_3C52_4CA8_AEAF_FB95B8CAEFB6
+#define INCLUDED_DeviceInfo_h_GUID_6E481CDC_3C52_4CA8_AEAF_FB95B8CAEFB6
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+#include <hidapi.h>
+
+// Standard includes
+#include <string>
+
+namespace hdklogger {
+/// Narrows a wide string from HIDAPI (serial numbers and the like, which are
+/// ASCII in practice) to a std::string, replacing anything else with '?'.
+inline std::string narrow(const wchar_t *str) {
+    std::string ret;
+    if (!str) {
+        return ret;
+    }
+    for (; *str; ++str) {
+        ret.push_back((*str > 0 && *str < 0x80) ? char(*str) : '?');
+    }
+    return ret;
+}
+
+/// The parts of a device's enumeration entry we need once the enumeration
+/// itself has been freed.
+struct DeviceInfo {
+    DeviceInfo() = default;
+    /// Copies the relevant fields from an enumeration entry.
+    explicit DeviceInfo(hid_device_info const &dev)
+        : path(dev.path ? dev.path : ""), vendorId(dev.vendor_id),
+          productId(dev.product_id), releaseNumber(dev.release_number),
+          serialNumber(narrow(dev.serial_number)) {}
+
+    std::string path;
+    unsigned short vendorId = 0;
+    unsigned short productId = 0;
+    unsigned short releaseNumber = 0;
+    std::string serialNumber;
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_DeviceInfo_h_GUID_6E481CDC_3C52_4CA8_AEAF_FB95B8CAEFB6
@@ -0,0 +1,95 @@
+/** @file
+    @brief Header with 64-bit seek and tell for stdio files.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_FileOffset_h_GUID_EB5F689A_76B1_4E6C_986D_F7AAC68EBDDD
+#define INCLUDED_FileOffset_h_GUID_EB5F689A_76B1_4E6C_986D_F7AAC68EBDDD
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#endif
+
+namespace hdklogger {
+/// @name 64-bit file offsets
+/// @brief std::fseek() and std::ftell() take a long, which is 32 bits on
+/// Windows: these work with captures over 2 GiB everywhere.
+/// @{
+/// Moves a file's position as std::fseek() does, returning false if it
+/// can't (including if the offset doesn't fit the platform's file offsets).
+inline bool file_seek(std::FILE *file, std::int64_t offset, int whence) {
+#if defined(_WIN32)
+    return 0 == ::_fseeki64(file, offset, whence);
+#elif defined(__unix__) || defined(__APPLE__)
+    if (offset > std::int64_t(std::numeric_limits<off_t>::max())) {
+        return false;
+    }
+    return 0 == ::fseeko(file, off_t(offset), whence);
+#else
+    if (offset > std::int64_t(std::numeric_limits<long>::max())) {
+        return false;
+    }
+    return 0 == std::fseek(file, long(offset), whence);
+#endif
+}
+
+/// @overload
+/// For unsigned offsets from the start of the file.
+inline bool file_seek(std::FILE *file, std::uint64_t offset) {
+    return offset <= std::uint64_t(std::numeric_limits<std::int64_t>::max()) &&
+           file_seek(file, std::int64_t(offset), SEEK_SET);
+}
+
+/// A file's position, as std::ftell() gives it: negative if unknown, such as
+/// for a pipe.
+inline std::int64_t file_tell(std::FILE *file) {
+#if defined(_WIN32)
+    return ::_ftelli64(file);
+#elif defined(__unix__) || defined(__APPLE__)
+    return ::ftello(file);
+#else
+    return std::ftell(file);
+#endif
+}
+
+/// A file's size, leaving its position at the end: negative if unknown.
+inline std::int64_t file_size(std::FILE *file) {
+    if (!file_seek(file, 0, SEEK_END)) {
+        return -1;
+    }
+    return file_tell(file);
+}
+/// @}
+} // namespace hdklogger
+
+#endif // INCLUDED_FileOffset_h_GUID_EB5F689A_76B1_4E6C_986D_F7AAC68EBDDD
@@ -0,0 +1,471 @@
+/** @file
+    @brief Header defining a buffered output file that commits writes in groups,
+    with a choice of how they are made durable.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_GroupCommitFile_h_GUID_3A18D1BD_7711_45F6_B259_EB69A64F4E99
+#define INCLUDED_GroupCommitFile_h_GUID_3A18D1BD_7711_45F6_B259_EB69A64F4E99
+
+// Internal Includes
+#include "Clock.h"
+#include "FileOffset.h"
+#include "Histogram.h"
+#include "Trace.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <algorithm>
+#include <cerrno>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HDKLOGGER_HAVE_POSIX_FILE_IO
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hdklogger {
+/// How a GroupCommitFile makes what it writes durable.
+enum class SyncPolicy {
+    /// Leave writing back the page cache to the OS.
+    None,
+    /// fdatasync() after flushing, at most once per sync interval.
+    Periodic,
+    /// Write around the page cache with O_DIRECT, from aligned buffers.
+    Direct
+};
+
+inline const char *to_string(SyncPolicy policy) {
+    switch (policy) {
+    case SyncPolicy::None:
+        return "none";
+    case SyncPolicy::Periodic:
+        return "periodic";
+    case SyncPolicy::Direct:
+        return "direct";
+    }
+    return "unknown";
+}
+
+/// Parses a sync policy name, as produced by to_string(). Returns false if it
+/// is not one.
+inline bool parse_sync_policy(std::string const &name, SyncPolicy &policy) {
+    for (auto candidate :
+         {SyncPolicy::None, SyncPolicy::Periodic, SyncPolicy::Direct}) {
+        if (name == to_string(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Can this build use the given sync policy? (Whether a particular file
+/// system supports O_DIRECT is only known once a file is opened.)
+inline bool sync_policy_available(SyncPolicy policy) {
+    switch (policy) {
+    case SyncPolicy::None:
+        return true;
+    case SyncPolicy::Periodic:
+#ifdef HDKLOGGER_HAVE_POSIX_FILE_IO
+        return true;
+#else
+        return false;
+#endif
+    case SyncPolicy::Direct:
+#if defined(HDKLOGGER_HAVE_POSIX_FILE_IO) && defined(O_DIRECT)
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+/// Alignment of a GroupCommitFile's buffer, and of its O_DIRECT writes.
+static const std::size_t WRITE_ALIGNMENT = 4096;
+
+/// When a GroupCommitFile writes, and how durably.
+struct GroupCommitSettings {
+    /// Write out once this many bytes are buffered.
+    std::size_t flushBytes = 1024 * 1024;
+    /// Write out anything buffered for this long, in nanoseconds, even short
+    /// of flushBytes: 0 only writes out when the buffer fills.
+    std::int64_t flushInterval = 100000000;
+    SyncPolicy sync = SyncPolicy::None;
+    /// With SyncPolicy::Periodic, the least time between fdatasync() calls,
+    /// in nanoseconds: 0 syncs after every write.
+    std::int64_t syncInterval = 1000000000;
+};
+
+/// An output file that gathers appended data into one large aligned buffer,
+/// and writes it out when enough has built up or it has waited long enough.
+/// Each write (and sync) is timed, so the cost of the chosen durability can
+/// be seen.
+///
+/// With SyncPolicy::Direct, the file is written with O_DIRECT: only whole
+/// aligned blocks, at aligned offsets. A partial final block is written
+/// padded, the file truncated back to its true length, and the block kept in
+/// the buffer to be written again once more follows. If the file system
+/// can't do O_DIRECT, Periodic is used instead: see policy().
+///
+/// Not thread-safe, except that the latency histograms may be read from any
+/// thread.
+class GroupCommitFile {
+  public:
+    /// Constructor: creates (or truncates) the file. Throws
+    /// std::runtime_error if it can't be.
+    GroupCommitFile(std::string const &path,
+                    GroupCommitSettings const &settings = GroupCommitSettings{})
+        : settings_(settings), policy_(settings.sync),
+          flushBytes_(
+              round_up_(std::max(settings.flushBytes, WRITE_ALIGNMENT))),
+          capacity_(flushBytes_ + WRITE_ALIGNMENT) {
+        open_(path);
+        void *buffer = nullptr;
+#ifdef HDKLOGGER_HAVE_POSIX_FILE_IO
+        if (0 != posix_memalign(&buffer, WRITE_ALIGNMENT, capacity_)) {
+            buffer = nullptr;
+        }
+#else
+        buffer = std::malloc(capacity_);
+#endif
+        if (!buffer) {
+            close_();
+            throw std::runtime_error("Could not allocate write buffer for " +
+                                     path);
+        }
+        buffer_.reset(static_cast<std::uint8_t *>(buffer));
+        lastSync_ = monotonic_now();
+    }
+
+    ~GroupCommitFile() { close(); }
+
+    GroupCommitFile(GroupCommitFile const &) = delete;
+    GroupCommitFile &operator=(GroupCommitFile const &) = delete;
+
+    /// Returns room for @p n bytes (at most WRITE_ALIGNMENT) at the end of the
+    /// buffer, writing out what is buffered first if need be. Fill it, then
+    /// commit() it.
+    std::uint8_t *reserve(std::size_t n) {
+        if (capacity_ - used_ < n) {
+            flush();
+        }
+        return buffer_.get() + used_;
+    }
+
+    /// Appends the @p n bytes just filled in after reserve(): writes out the
+    /// buffer if that fills it.
+    void commit(std::size_t n) {
+        if (used_ == written_) {
+            pendingSince_ = monotonic_now();
+        }
+        used_ += n;
+        if (used_ >= flushBytes_) {
+            flush();
+        }
+    }
+
+    /// Appends @p n bytes.
+    void append(const void *data, std::size_t n) {
+        auto src = static_cast<std::uint8_t const *>(data);
+        while (n) {
+            auto chunk = std::min(n, WRITE_ALIGNMENT);
+            std::memcpy(reserve(chunk), src, chunk);
+            commit(chunk);
+            src += chunk;
+            n -= chunk;
+        }
+    }
+
+    /// Writes out what is buffered if it has waited for the flush interval.
+    /// Call regularly, whether or not anything has been appended.
+    void poll(std::int64_t now = monotonic_now()) {
+        if (settings_.flushInterval > 0 && used_ != written_ &&
+            now - pendingSince_ >= settings_.flushInterval) {
+            flush();
+        }
+    }
+
+    /// Writes out everything buffered now, then syncs if the policy says it
+    /// is time to.
+    void flush() {
+        if (used_ == written_ || !open()) {
+            return;
+        }
+        auto len = used_;
+        if (direct_) {
+            /// Pad out the last block: the padding is truncated away below.
+            len = round_up_(used_);
+            std::memset(buffer_.get() + used_, 0, len - used_);
+        }
+        auto start = monotonic_now();
+        if (ok_ && !write_at_(buffer_.get(), len, offset_)) {
+            ok_ = false;
+        }
+        if (ok_ && len != used_ && !truncate_(offset_ + used_)) {
+            ok_ = false;
+        }
+        auto end = monotonic_now();
+        writeLatency_.record(std::uint64_t(end - start));
+        trace_span(TracePoint::Write, start, end, len);
+
+        /// With O_DIRECT, a partial last block stays in the buffer, to be
+        /// written again whole.
+        auto done = direct_ ? used_ / WRITE_ALIGNMENT * WRITE_ALIGNMENT : used_;
+        std::memmove(buffer_.get(), buffer_.get() + done, used_ - done);
+        offset_ += done;
+        used_ -= done;
+        written_ = used_;
+
+        if (policy_ == SyncPolicy::Periodic &&
+            end - lastSync_ >= settings_.syncInterval) {
+            sync();
+        }
+    }
+
+    /// Writes out everything buffered and makes the file durable, whatever
+    /// the policy.
+    void sync() {
+        flush();
+        if (!open()) {
+            return;
+        }
+        auto start = monotonic_now();
+        if (ok_ && !sync_()) {
+            ok_ = false;
+        }
+        lastSync_ = monotonic_now();
+        syncLatency_.record(std::uint64_t(lastSync_ - start));
+        trace_span(TracePoint::Sync, start, lastSync_, size());
+    }
+
+    /// Overwrites bytes already appended, such as a header that could only
+    /// be completed at the end. Only for use once done appending: with
+    /// O_DIRECT, it first switches back to ordinary writes. Returns false if
+    /// the file isn't seekable or the write fails.
+    bool patch(std::uint64_t offset, const void *data, std::size_t n) {
+        if (!open() || !seekable_ || offset + n > size()) {
+            return false;
+        }
+        end_direct_();
+        flush();
+        if (ok_ && !write_at_(data, n, offset)) {
+            ok_ = false;
+        }
+        return ok_;
+    }
+
+    /// Writes out everything buffered, syncs unless the policy is None, and
+    /// closes the file. Returns false if any write failed.
+    bool close() {
+        if (open()) {
+            end_direct_();
+            flush();
+            if (policy_ != SyncPolicy::None) {
+                sync();
+            }
+            if (!close_()) {
+                ok_ = false;
+            }
+        }
+        return ok_;
+    }
+
+    bool open() const {
+#ifdef HDKLOGGER_HAVE_POSIX_FILE_IO
+        return fd_ >= 0;
+#else
+        return file_ != nullptr;
+#endif
+    }
+
+    /// Have all writes so far succeeded?
+    bool ok() const { return ok_; }
+
+    /// Is this a regular file, that can be patched?
+    bool seekable() const { return seekable_; }
+
+    /// Bytes appended so far, buffered or not.
+    std::uint64_t size() const { return offset_ + used_; }
+
+    /// The sync policy in effect: Periodic if Direct was asked for but the
+    /// file system (or file) doesn't support it.
+    SyncPolicy policy() const { return policy_; }
+
+    /// @name Statistics
+    /// @{
+    /// How long each write of the buffer took, in nanoseconds.
+    Histogram const &write_latency() const { return writeLatency_; }
+    /// How long each sync took, in nanoseconds.
+    Histogram const &sync_latency() const { return syncLatency_; }
+    /// @}
+
+  private:
+    static std::size_t round_up_(std::size_t n) {
+        return (n + WRITE_ALIGNMENT - 1) / WRITE_ALIGNMENT * WRITE_ALIGNMENT;
+    }
+
+    struct FreeDeleter {
+        void operator()(std::uint8_t *p) { std::free(p); }
+    };
+
+#ifdef HDKLOGGER_HAVE_POSIX_FILE_IO
+    void open_(std::string const &path) {
+        do {
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        } while (fd_ < 0 && errno == EINTR);
+        if (fd_ < 0) {
+            throw std::runtime_error("Could not create output file " + path +
+                                     ": " + std::strerror(errno));
+        }
+        struct stat st;
+        seekable_ = 0 == fstat(fd_, &st) && S_ISREG(st.st_mode);
+        if (policy_ == SyncPolicy::Direct) {
+#ifdef O_DIRECT
+            auto flags = fcntl(fd_, F_GETFL);
+            direct_ = seekable_ && flags >= 0 &&
+                      0 == fcntl(fd_, F_SETFL, flags | O_DIRECT);
+#endif
+            if (!direct_) {
+                policy_ = SyncPolicy::Periodic;
+            }
+        }
+    }
+
+    bool write_at_(const void *data, std::size_t n, std::uint64_t offset) {
+        auto src = static_cast<const char *>(data);
+        while (n) {
+            auto ret = seekable_ ? ::pwrite(fd_, src, n, off_t(offset))
+                                 : ::write(fd_, src, n);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            src += ret;
+            n -= std::size_t(ret);
+            offset += std::uint64_t(ret);
+        }
+        return true;
+    }
+
+    bool truncate_(std::uint64_t length) {
+        return 0 == ::ftruncate(fd_, off_t(length));
+    }
+
+    bool sync_() {
+        if (!seekable_) {
+            return true;
+        }
+#ifdef __APPLE__
+        return 0 == ::fsync(fd_);
+#else
+        return 0 == ::fdatasync(fd_);
+#endif
+    }
+
+    void end_direct_() {
+#ifdef O_DIRECT
+        if (direct_) {
+            flush();
+            auto flags = fcntl(fd_, F_GETFL);
+            if (flags < 0 || 0 != fcntl(fd_, F_SETFL, flags & ~O_DIRECT)) {
+                ok_ = false;
+            }
+            direct_ = false;
+        }
+#endif
+    }
+
+    bool close_() {
+        auto ret = ::close(fd_);
+        fd_ = -1;
+        return ret == 0;
+    }
+
+    int fd_ = -1;
+#else
+    void open_(std::string const &path) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) {
+            throw std::runtime_error("Could not create output file " + path);
+        }
+        std::setvbuf(file_, nullptr, _IONBF, 0);
+        seekable_ = file_tell(file_) >= 0;
+        /// Only None is available here.
+        policy_ = SyncPolicy::None;
+    }
+
+    bool write_at_(const void *data, std::size_t n, std::uint64_t offset) {
+        if (seekable_ && !file_seek(file_, offset)) {
+            return false;
+        }
+        return std::fwrite(data, 1, n, file_) == n;
+    }
+
+    bool truncate_(std::uint64_t) { return false; }
+    bool sync_() { return 0 == std::fflush(file_); }
+    void end_direct_() {}
+
+    bool close_() {
+        auto ret = std::fclose(file_);
+        file_ = nullptr;
+        return ret == 0;
+    }
+
+    std::FILE *file_ = nullptr;
+#endif
+
+    GroupCommitSettings settings_;
+    SyncPolicy policy_;
+    bool direct_ = false;
+    bool seekable_ = false;
+    bool ok_ = true;
+    std::size_t flushBytes_;
+    std::size_t capacity_;
+    std::unique_ptr<std::uint8_t, FreeDeleter> buffer_;
+    /// Bytes in the buffer, and how many of those are already in the file.
+    std::size_t used_ = 0;
+    std::size_t written_ = 0;
+    /// File offset of the start of the buffer.
+    std::uint64_t offset_ = 0;
+    std::int64_t pendingSince_ = 0;
+    std::int64_t lastSync_ = 0;
+    Histogram writeLatency_;
+    Histogram syncLatency_;
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_GroupCommitFile_h_GUID_3A18D1BD_7711_45F6_B259_EB69A64F4E99
@@ -0,0 +1,96 @@
+/** @file
+    @brief Header with constants and report types for the OSVR HDK tracker.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_HDK_h_GUID_57BC8CA6_6DBC_435B_9572_913BA1A25335
+#define INCLUDED_HDK_h_GUID_57BC8CA6_6DBC_435B_9572_913BA1A25335
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+#include "hidapipp/Report.h"
+
+// Standard includes
+#include <cstddef> // for std::size_t
+#include <cstdint>
+
+namespace hdklogger {
+/// USB vendor ID of the HDK tracker.
+static const unsigned short HDK_VID = 0x1532;
+/// USB product ID of the HDK tracker.
+static const unsigned short HDK_PID = 0x0b00;
+/// Largest report the HDK tracker sends.
+static const std::size_t HDK_MAX_REPORT_LENGTH = 32;
+/// Nominal time between reports, in nanoseconds: the HDK tracker reports at
+/// 1 kHz.
+static const std::int64_t HDK_REPORT_PERIOD_NS = 1000000;
+
+/// @name Report layout
+/// @brief Byte 0 holds the report version in its low nibble (later firmware
+/// uses the high nibble for status flags), byte 1 a sequence number.
+///
+/// Bytes 2-9 hold the orientation quaternion as little-endian int16 i, j, k
+/// and real parts, in Q1.14 fixed point. From version 2 on, bytes 10-15 hold
+/// the angular velocity: the vector part (x, y, z) of the incremental
+/// rotation over HDK_VELOCITY_DT seconds, as little-endian int16 in Q6.9
+/// fixed point.
+/// @{
+static const std::uint8_t HDK_VERSION_MASK = 0x0f;
+static const std::size_t HDK_SEQUENCE_OFFSET = 1;
+static const std::size_t HDK_QUATERNION_OFFSET = 2;
+static const int HDK_QUATERNION_FRACTIONAL_BITS = 14;
+static const std::size_t HDK_VELOCITY_OFFSET = 10;
+static const int HDK_VELOCITY_FRACTIONAL_BITS = 9;
+static const double HDK_VELOCITY_DT = 1. / 50.;
+/// First report version carrying angular velocity.
+static const std::uint8_t HDK_VELOCITY_MIN_VERSION = 2;
+/// Length needed for a report with just an orientation.
+static const std::size_t HDK_ORIENTATION_REPORT_LENGTH = 10;
+/// Length needed for a report with orientation and angular velocity.
+static const std::size_t HDK_VELOCITY_REPORT_LENGTH = 16;
+/// @}
+
+/// Does the given VID/PID pair identify an HDK tracker?
+inline bool is_hdk(unsigned short vid, unsigned short pid) {
+    return vid == HDK_VID && pid == HDK_PID;
+}
+} // namespace hdklogger
+
+namespace hidapi {
+/// HDK tracker reports fit in HDK_MAX_REPORT_LENGTH bytes.
+template <>
+struct DeviceReportTraits<hdklogger::HDK_VID, hdklogger::HDK_PID> {
+    static const std::size_t max_length = hdklogger::HDK_MAX_REPORT_LENGTH;
+};
+} // namespace hidapi
+
+namespace hdklogger {
+/// Inline, fixed-capacity buffer for a single HDK tracker report.
+using HDKReport = hidapi::ReportFor<HDK_VID, HDK_PID>;
+
+/// Batch of HDK tracker reports, for reading several at once.
+using HDKReportBatch = hidapi::ReportBatchFor<HDK_VID, HDK_PID>;
+} // namespace hdklogger
+
+#endif // INCLUDED_HDK_h_GUID_57BC8CA6_6DBC_435B_9572_913BA1A25335
@@ -0,0 +1,340 @@
+/** @file
+    @brief Header defining a native Linux hidraw device, read with epoll.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_HidrawDevice_h_GUID_500EF9DE_A9AE_4810_9C06_565899B2E16E
+#define INCLUDED_HidrawDevice_h_GUID_500EF9DE_A9AE_4810_9C06_565899B2E16E
+
+// Internal Includes
+#include "DeviceInfo.h"
+
+// Library/third-party includes
+#include "hidapipp/Device.h"
+
+// Standard includes
+#include <cerrno>
+#include <climits>
+#include <cstddef> // for std::size_t
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace hdklogger {
+/// A hidraw device node and the identity the kernel reports for it.
+struct HidrawNode {
+    std::string devnode;
+    unsigned short vendorId = 0;
+    unsigned short productId = 0;
+    std::string serialNumber;
+    /// Sysfs directory of the USB interface the device belongs to, such as
+    /// `/sys/devices/.../usb1/1-2/1-2:1.0`: empty if it isn't on USB.
+    std::string usbInterface;
+};
+
+namespace detail {
+    /// Reads a number from a sysfs attribute file, returning false if it
+    /// can't.
+    inline bool read_sysfs_number(std::string const &path, int base,
+                                  unsigned long &value) {
+        std::ifstream file(path);
+        std::string text;
+        if (!std::getline(file, text) || text.empty()) {
+            return false;
+        }
+        char *end = nullptr;
+        value = std::strtoul(text.c_str(), &end, base);
+        return end != text.c_str();
+    }
+
+    /// The USB interface directory above a hidraw node's HID device in
+    /// sysfs, or an empty string if it has none.
+    inline std::string hidraw_usb_interface(std::string const &sysfsNode) {
+        char resolved[PATH_MAX];
+        if (!::realpath((sysfsNode + "/device").c_str(), resolved)) {
+            return std::string();
+        }
+        std::string hid = resolved;
+        auto slash = hid.rfind('/');
+        if (slash == std::string::npos || slash == 0) {
+            return std::string();
+        }
+        auto ret = hid.substr(0, slash);
+        std::ifstream check(ret + "/bInterfaceNumber");
+        return check ? ret : std::string();
+    }
+} // namespace detail
+
+/// Lists hidraw device nodes (from sysfs), optionally filtered on VID/PID
+/// like hidapi::Enumeration.
+inline std::vector<HidrawNode> enumerate_hidraw(unsigned short vid = 0x0000,
+                                                unsigned short pid = 0x0000) {
+    std::vector<HidrawNode> ret;
+    static const char SYSFS_HIDRAW[] = "/sys/class/hidraw";
+    auto dir = opendir(SYSFS_HIDRAW);
+    if (!dir) {
+        return ret;
+    }
+    while (auto entry = readdir(dir)) {
+        if (0 != std::strncmp(entry->d_name, "hidraw", 6)) {
+            continue;
+        }
+        std::ifstream uevent(std::string(SYSFS_HIDRAW) + "/" + entry->d_name +
+                             "/device/uevent");
+        HidrawNode node;
+        node.devnode = std::string("/dev/") + entry->d_name;
+        node.usbInterface = detail::hidraw_usb_interface(
+            std::string(SYSFS_HIDRAW) + "/" + entry->d_name);
+        std::string line;
+        while (std::getline(uevent, line)) {
+            if (line.compare(0, 7, "HID_ID=") == 0) {
+                /// Format is bus:vid:pid, in hex.
+                auto vidStart = line.find(':');
+                auto pidStart = line.find(':', vidStart + 1);
+                if (pidStart == std::string::npos) {
+                    continue;
+                }
+                node.vendorId = static_cast<unsigned short>(std::strtoul(
+                    line.c_str() + vidStart + 1, nullptr, 16));
+                node.productId = static_cast<unsigned short>(std::strtoul(
+                    line.c_str() + pidStart + 1, nullptr, 16));
+            } else if (line.compare(0, 9, "HID_UNIQ=") == 0) {
+                node.serialNumber = line.substr(9);
+            }
+        }
+        if ((vid == 0 || vid == node.vendorId) &&
+            (pid == 0 || pid == node.productId)) {
+            ret.push_back(node);
+        }
+    }
+    closedir(dir);
+    return ret;
+}
+
+/// Does a HIDAPI libusb backend path name the given USB interface? Newer
+/// versions use the interface's sysfs name (such as `1-2:1.0`), older ones
+/// bus number, device address and interface number, in hex
+/// (`0001:0004:00`).
+inline bool is_usb_interface(std::string const &path,
+                             std::string const &usbInterface) {
+    if (usbInterface.empty()) {
+        return false;
+    }
+    auto slash = usbInterface.rfind('/');
+    if (path == usbInterface.substr(slash + 1)) {
+        return true;
+    }
+    unsigned bus = 0, address = 0, interface = 0;
+    char extra = 0;
+    if (std::sscanf(path.c_str(), "%x:%x:%x%c", &bus, &address, &interface,
+                    &extra) != 3) {
+        return false;
+    }
+    unsigned long busnum = 0, devnum = 0, ifnum = 0;
+    auto device = usbInterface.substr(0, slash);
+    return detail::read_sysfs_number(device + "/busnum", 10, busnum) &&
+           detail::read_sysfs_number(device + "/devnum", 10, devnum) &&
+           detail::read_sysfs_number(usbInterface + "/bInterfaceNumber", 16,
+                                     ifnum) &&
+           busnum == bus && devnum == address && ifnum == interface;
+}
+
+/// Finds the hidraw device node for a device found through HIDAPI
+/// enumeration: the one on the USB interface its path names. Returns an
+/// empty string if there is none, or the path can't be matched to one, so
+/// that two trackers never end up sharing a node.
+inline std::string find_hidraw_node(DeviceInfo const &info) {
+    /// The hidraw HIDAPI backend already uses the device node as the path.
+    if (info.path.compare(0, 11, "/dev/hidraw") == 0) {
+        return info.path;
+    }
+    for (auto const &node : enumerate_hidraw(info.vendorId, info.productId)) {
+        if (is_usb_interface(info.path, node.usbInterface)) {
+            return node.devnode;
+        }
+    }
+    return std::string();
+}
+
+/// A HID device read directly through its Linux hidraw device node, waiting
+/// with epoll rather than going through HIDAPI's backends (and, for libusb,
+/// its extra thread and report queue).
+///
+/// Most functionality provided by hidapi::DeviceBase.
+class HidrawDevice : public hidapi::DeviceBase<HidrawDevice> {
+  public:
+    using base = hidapi::DeviceBase<HidrawDevice>;
+    /// Default, empty constructor. Not very useful on its own, mostly for move
+    /// assignment.
+    HidrawDevice() : base() {}
+
+    /// Constructor from a device node path such as `/dev/hidraw0`.
+    explicit HidrawDevice(std::string const &devnode) : base() {
+        fd_ = ::open(devnode.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd_ < 0) {
+            fail_("open");
+            return;
+        }
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        if (epoll_ < 0 || epoll_ctl(epoll_, EPOLL_CTL_ADD, fd_, &ev) < 0) {
+            fail_("epoll setup");
+            close_();
+        }
+    }
+
+    ~HidrawDevice() { close_(); }
+
+    /// Move constructor
+    HidrawDevice(HidrawDevice &&other)
+        : base(), fd_(other.fd_), epoll_(other.epoll_),
+          nonblocking_(other.nonblocking_),
+          lastError_(std::move(other.lastError_)) {
+        other.fd_ = -1;
+        other.epoll_ = -1;
+    }
+
+    /// Move assignment
+    HidrawDevice &operator=(HidrawDevice &&other) {
+        if (&other == this) {
+            return *this;
+        }
+        close_();
+        fd_ = other.fd_;
+        epoll_ = other.epoll_;
+        nonblocking_ = other.nonblocking_;
+        lastError_ = std::move(other.lastError_);
+        other.fd_ = -1;
+        other.epoll_ = -1;
+        return *this;
+    }
+
+    /// Not copy constructible
+    HidrawDevice(HidrawDevice const &) = delete;
+    /// Not copy assignable
+    HidrawDevice &operator=(HidrawDevice const &) = delete;
+
+    /// Not backed by a HIDAPI device.
+    hid_device *get() const { return nullptr; }
+
+    /// The device node's file descriptor.
+    int fd() const { return fd_; }
+
+    /// Sets whether read() waits for a report (the default) or returns
+    /// immediately, like `hid_set_nonblocking()`.
+    void set_nonblocking(bool nonblocking) { nonblocking_ = nonblocking; }
+
+    /// Error message from the last failed operation, e.g. on opening.
+    const wchar_t *last_error() const {
+        return lastError_.empty() ? nullptr : lastError_.c_str();
+    }
+
+  private:
+    friend class hidapi::DeviceBase<HidrawDevice>;
+
+    bool valid_impl() const { return fd_ >= 0; }
+
+    int read_impl(hidapi::DataByte *buf, std::size_t maxLength) {
+        return read_timeout_impl(buf, maxLength, nonblocking_ ? 0 : -1);
+    }
+
+    int read_timeout_impl(hidapi::DataByte *buf, std::size_t maxLength,
+                          int milliseconds) {
+        for (;;) {
+            /// Try first: if a report is already waiting, this is the only
+            /// syscall.
+            auto n = ::read(fd_, buf, maxLength);
+            if (n >= 0) {
+                return static_cast<int>(n);
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return fail_("read");
+            }
+            if (milliseconds == 0) {
+                return 0;
+            }
+            epoll_event ev;
+            auto ready = epoll_wait(epoll_, &ev, 1, milliseconds);
+            if (ready < 0) {
+                /// Interrupted by a signal: report nothing read, so the
+                /// caller gets a chance to react to it.
+                return errno == EINTR ? 0 : fail_("epoll_wait");
+            }
+            if (ready == 0) {
+                return 0;
+            }
+            if ((ev.events & (EPOLLERR | EPOLLHUP)) && !(ev.events & EPOLLIN)) {
+                errno = ENODEV;
+                return fail_("read");
+            }
+        }
+    }
+
+    int get_feature_report_impl(hidapi::DataByte *buf, std::size_t length) {
+        auto ret = ioctl(fd_, HIDIOCGFEATURE(length), buf);
+        return ret < 0 ? fail_("get feature report") : ret;
+    }
+
+    const wchar_t *error_impl() { return lastError_.c_str(); }
+
+    /// Records an error message from errno, returning -1.
+    int fail_(const char *what) {
+        std::string msg =
+            std::string("hidraw ") + what + ": " + std::strerror(errno);
+        lastError_.assign(msg.begin(), msg.end());
+        return -1;
+    }
+
+    void close_() {
+        if (epoll_ >= 0) {
+            ::close(epoll_);
+            epoll_ = -1;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    int fd_ = -1;
+    int epoll_ = -1;
+    bool nonblocking_ = false;
+    std::wstring lastError_;
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_HidrawDevice_h_GUID_500EF9DE_A9AE_4810_9C06_565899B2E16E
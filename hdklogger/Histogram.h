@@ -0,0 +1,158 @@
+/** @file
+    @brief Header defining a fixed-memory, log-linear (HDR-style) histogram.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Histogram_h_GUID_EE0E4D59_93EF_4F50_968F_B0463BFF1636
+#define INCLUDED_Histogram_h_GUID_EE0E4D59_93EF_4F50_968F_B0463BFF1636
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <atomic>
+#include <cmath>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+
+namespace hdklogger {
+/// A histogram of non-negative integer values (typically nanoseconds) with
+/// log-linear buckets, in the style of HdrHistogram: each power-of-two range
+/// is split into SUB_BUCKET_COUNT equal buckets, so any recorded value is
+/// known to within 1/SUB_BUCKET_COUNT of itself.
+///
+/// All memory is inside the object, so nothing is allocated after it is
+/// created. record() is meant for a single thread (it uses relaxed
+/// single-writer updates rather than read-modify-write atomics); the queries
+/// may be made from any thread and see a slightly stale but consistent enough
+/// view.
+class Histogram {
+  public:
+    static const unsigned SUB_BUCKET_BITS = 7;
+    static const std::size_t SUB_BUCKET_COUNT = std::size_t(1)
+                                                << SUB_BUCKET_BITS;
+    static const std::size_t BUCKET_COUNT =
+        (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    Histogram() {
+        for (auto &bucket : buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    Histogram(Histogram const &) = delete;
+    Histogram &operator=(Histogram const &) = delete;
+
+    /// Records a value.
+    void record(std::uint64_t value) {
+        increment(buckets_[bucket_index(value)]);
+        increment(count_);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    /// Number of values recorded.
+    std::uint64_t count() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    /// Largest value recorded (exactly).
+    std::uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    /// Gets the value at the given percentile (0-100): the highest value
+    /// equivalent to (sharing a bucket with) the recorded value at that rank,
+    /// capped at max(). Returns 0 if nothing has been recorded.
+    std::uint64_t percentile(double pct) const {
+        auto total = count();
+        if (total == 0) {
+            return 0;
+        }
+        auto rank = std::uint64_t(std::ceil(pct / 100. * double(total)));
+        if (rank < 1) {
+            rank = 1;
+        }
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                auto high = bucket_highest(i);
+                return high < max() ? high : max();
+            }
+        }
+        return max();
+    }
+
+    /// Index of the bucket holding a value.
+    static std::size_t bucket_index(std::uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) {
+            return std::size_t(value);
+        }
+        auto shift = highest_bit(value) - SUB_BUCKET_BITS;
+        auto top = std::size_t(value >> shift); // in [SUB, 2 * SUB)
+        return (shift + 1) * SUB_BUCKET_COUNT + (top - SUB_BUCKET_COUNT);
+    }
+
+    /// Smallest value that lands in a bucket.
+    static std::uint64_t bucket_lowest(std::size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        auto shift = unsigned(index / SUB_BUCKET_COUNT - 1);
+        auto top = std::uint64_t(SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT);
+        return top << shift;
+    }
+
+    /// Largest value that lands in a bucket.
+    static std::uint64_t bucket_highest(std::size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        auto shift = unsigned(index / SUB_BUCKET_COUNT - 1);
+        return bucket_lowest(index) + ((std::uint64_t(1) << shift) - 1);
+    }
+
+  private:
+    using Counter = std::atomic<std::uint64_t>;
+    static void increment(Counter &c) {
+        c.store(c.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+    }
+
+    static unsigned highest_bit(std::uint64_t value) {
+        unsigned ret = 0;
+        while (value >>= 1) {
+            ++ret;
+        }
+        return ret;
+    }
+
+    Counter buckets_[BUCKET_COUNT];
+    Counter count_{0};
+    Counter max_{0};
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_Histogram_h_GUID_EE0E4D59_93EF_4F50_968F_B0463BFF1636
@@ -0,0 +1,338 @@
+/** @file
+    @brief Header with a memory-mapped, zero-copy reader for binary capture
+   files (POSIX).
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_MappedCapture_h_GUID_3F076FF3_D13E_449A_94BC_2278801EAEF8
+#define INCLUDED_MappedCapture_h_GUID_3F076FF3_D13E_449A_94BC_2278801EAEF8
+
+// Internal Includes
+#include "BinaryFormat.h"
+#include "Decoder.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <algorithm>
+#include <cerrno>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hdklogger {
+/// Read-only view of one record of a binary capture, in place.
+class RecordView {
+  public:
+    explicit RecordView(std::uint8_t const *record) : record_(record) {}
+
+    std::uint8_t const *get() const { return record_; }
+    std::int64_t timestamp() const { return binary::record_timestamp(record_); }
+    std::size_t length() const { return binary::record_length(record_); }
+    std::uint8_t const *data() const { return binary::record_data(record_); }
+    /// The recorded report, for decoding.
+    ReportView report() const { return ReportView{data(), length()}; }
+
+  private:
+    std::uint8_t const *record_;
+};
+
+/// Random-access iterator over the records of a mapped capture. Dereferences
+/// to a RecordView by value.
+class RecordIterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = RecordView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = RecordView;
+
+    RecordIterator() = default;
+    explicit RecordIterator(std::uint8_t const *record) : record_(record) {}
+
+    RecordView operator*() const { return RecordView{record_}; }
+    RecordView operator[](difference_type n) const { return *(*this + n); }
+
+    RecordIterator &operator++() { return *this += 1; }
+    RecordIterator operator++(int) {
+        auto ret = *this;
+        ++*this;
+        return ret;
+    }
+    RecordIterator &operator--() { return *this -= 1; }
+    RecordIterator operator--(int) {
+        auto ret = *this;
+        --*this;
+        return ret;
+    }
+    RecordIterator &operator+=(difference_type n) {
+        record_ += n * difference_type(binary::RECORD_SIZE);
+        return *this;
+    }
+    RecordIterator &operator-=(difference_type n) { return *this += -n; }
+    RecordIterator operator+(difference_type n) const {
+        return RecordIterator{*this} += n;
+    }
+    RecordIterator operator-(difference_type n) const {
+        return RecordIterator{*this} -= n;
+    }
+    difference_type operator-(RecordIterator const &other) const {
+        return (record_ - other.record_) /
+               difference_type(binary::RECORD_SIZE);
+    }
+
+    bool operator==(RecordIterator const &other) const {
+        return record_ == other.record_;
+    }
+    bool operator!=(RecordIterator const &other) const {
+        return record_ != other.record_;
+    }
+    bool operator<(RecordIterator const &other) const {
+        return record_ < other.record_;
+    }
+    bool operator>(RecordIterator const &other) const {
+        return record_ > other.record_;
+    }
+    bool operator<=(RecordIterator const &other) const {
+        return record_ <= other.record_;
+    }
+    bool operator>=(RecordIterator const &other) const {
+        return record_ >= other.record_;
+    }
+
+  private:
+    std::uint8_t const *record_ = nullptr;
+};
+
+/// How a mapped capture is about to be read, for the kernel's read-ahead.
+enum class AccessPattern { Normal, Sequential, Random, WillNeed };
+
+/// A binary capture file mapped into memory, read-only: its header is
+/// validated once on opening, and its records are then read in place, with
+/// no read() calls or copies.
+///
+/// A truncated final record, as left by a crash mid-write, is not counted
+/// among the records: see truncated().
+class MappedCapture {
+  public:
+    /// Default, empty constructor, mostly for move assignment.
+    MappedCapture() = default;
+
+    /// Constructor: maps a capture file, advising the kernel of a
+    /// sequential scan. Throws std::runtime_error if it cannot be mapped or
+    /// is not a capture file.
+    explicit MappedCapture(std::string const &path) {
+        auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open capture file " + path +
+                                     ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            auto err = errno;
+            ::close(fd);
+            throw std::runtime_error("Could not stat capture file " + path +
+                                     ": " + std::strerror(err));
+        }
+        size_ = std::size_t(st.st_size);
+        if (size_ >= binary::HEADER_SIZE) {
+            auto mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data_ = static_cast<std::uint8_t const *>(mapped);
+            }
+        }
+        /// The mapping stays valid once the descriptor is closed.
+        ::close(fd);
+        if (!data_ || !binary::decode_header(data_, size_, header_)) {
+            unmap_();
+            throw std::runtime_error(path + " is not a capture file");
+        }
+        recordsEnd_ = std::size_t(binary::records_end(header_, size_));
+        records_ = (recordsEnd_ - binary::HEADER_SIZE) / binary::RECORD_SIZE;
+        auto indexOffset = std::size_t(header_.indexOffset);
+        std::uint32_t interval = 0;
+        std::uint64_t entries = 0;
+        if (indexOffset && indexOffset < size_ &&
+            binary::decode_index_header(data_ + indexOffset,
+                                        size_ - indexOffset, interval,
+                                        entries)) {
+            index_ = data_ + indexOffset + binary::INDEX_HEADER_SIZE;
+            indexEntries_ = std::size_t(entries);
+        }
+        advise(AccessPattern::Sequential);
+    }
+
+    ~MappedCapture() { unmap_(); }
+
+    /// Move constructor
+    MappedCapture(MappedCapture &&other)
+        : data_(other.data_), size_(other.size_),
+          recordsEnd_(other.recordsEnd_), records_(other.records_),
+          index_(other.index_), indexEntries_(other.indexEntries_),
+          header_(std::move(other.header_)) {
+        other.data_ = other.index_ = nullptr;
+        other.size_ = other.recordsEnd_ = other.records_ = 0;
+        other.indexEntries_ = 0;
+    }
+
+    /// Move assignment
+    MappedCapture &operator=(MappedCapture &&other) {
+        if (&other == this) {
+            return *this;
+        }
+        unmap_();
+        data_ = other.data_;
+        size_ = other.size_;
+        recordsEnd_ = other.recordsEnd_;
+        records_ = other.records_;
+        index_ = other.index_;
+        indexEntries_ = other.indexEntries_;
+        header_ = std::move(other.header_);
+        other.data_ = other.index_ = nullptr;
+        other.size_ = other.recordsEnd_ = other.records_ = 0;
+        other.indexEntries_ = 0;
+        return *this;
+    }
+
+    /// Not copy constructible
+    MappedCapture(MappedCapture const &) = delete;
+    /// Not copy assignable
+    MappedCapture &operator=(MappedCapture const &) = delete;
+
+    explicit operator bool() const { return data_ != nullptr; }
+
+    binary::Header const &header() const { return header_; }
+
+    /// @name Records
+    /// @{
+    std::size_t size() const { return records_; }
+    bool empty() const { return records_ == 0; }
+    RecordView operator[](std::size_t i) const {
+        return RecordView{record_ptr(i)};
+    }
+    RecordIterator begin() const { return RecordIterator{record_ptr(0)}; }
+    RecordIterator end() const { return RecordIterator{record_ptr(records_)}; }
+    /// The raw bytes of record @p i, with the rest following it contiguously
+    /// (as decode_records() and SampleStore::append_records() take them).
+    std::uint8_t const *record_ptr(std::size_t i) const {
+        return data_ + binary::HEADER_SIZE + i * binary::RECORD_SIZE;
+    }
+    /// @}
+
+    /// Do the records end with a partial one?
+    bool truncated() const {
+        return data_ && recordsEnd_ != binary::HEADER_SIZE +
+                                           records_ * binary::RECORD_SIZE;
+    }
+
+    /// @name Seeking by time
+    /// @{
+    /// Does the file have a time index? Seeking works without one, but
+    /// touches pages all over the file rather than a few at its end.
+    bool has_index() const { return index_ != nullptr; }
+    std::size_t index_size() const { return indexEntries_; }
+    binary::IndexEntry index_entry(std::size_t k) const {
+        return binary::decode_index_entry(index_ +
+                                          k * binary::INDEX_ENTRY_SIZE);
+    }
+
+    /// Finds the first record with a timestamp of at least @p timestamp, or
+    /// size() if there is none, in O(log n).
+    std::size_t find(std::int64_t timestamp) const {
+        return std::size_t(binary::find_record(
+            timestamp, records_,
+            [&](std::uint64_t i) {
+                return binary::record_timestamp(record_ptr(std::size_t(i)));
+            },
+            indexEntries_,
+            [&](std::uint64_t k) { return index_entry(std::size_t(k)); }));
+    }
+
+    /// As find(), but as an iterator.
+    RecordIterator seek(std::int64_t timestamp) const {
+        return begin() + std::ptrdiff_t(find(timestamp));
+    }
+    /// @}
+
+    /// Tells the kernel how records [first, first + count) are about to be
+    /// read. Only a hint: failures are ignored.
+    void advise(AccessPattern pattern, std::size_t first,
+                std::size_t count) const {
+        if (!data_ || count == 0) {
+            return;
+        }
+        /// madvise needs a page-aligned start.
+        auto page = std::size_t(sysconf(_SC_PAGESIZE));
+        auto begin = std::size_t(record_ptr(first) - data_) / page * page;
+        auto end = std::size_t(record_ptr(first + count) - data_);
+        int advice = MADV_NORMAL;
+        switch (pattern) {
+        case AccessPattern::Sequential:
+            advice = MADV_SEQUENTIAL;
+            break;
+        case AccessPattern::Random:
+            advice = MADV_RANDOM;
+            break;
+        case AccessPattern::WillNeed:
+            advice = MADV_WILLNEED;
+            break;
+        default:
+            break;
+        }
+        madvise(const_cast<std::uint8_t *>(data_) + begin,
+                std::min(end, size_) - begin, advice);
+    }
+
+    /// @overload
+    /// For the whole file.
+    void advise(AccessPattern pattern) const {
+        advise(pattern, 0, records_);
+    }
+
+  private:
+    void unmap_() {
+        if (data_) {
+            munmap(const_cast<std::uint8_t *>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+
+    std::uint8_t const *data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t recordsEnd_ = 0;
+    std::size_t records_ = 0;
+    std::uint8_t const *index_ = nullptr;
+    std::size_t indexEntries_ = 0;
+    binary::Header header_;
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_MappedCapture_h_GUID_3F076FF3_D13E_449A_94BC_2278801EAEF8
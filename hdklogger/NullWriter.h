@@ -0,0 +1,49 @@
+/** @file
+    @brief Header defining a sink that discards captured reports.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_NullWriter_h_GUID_E4EA6BD5_3699_47FB_837F_CB48E1D4AF97
+#define INCLUDED_NullWriter_h_GUID_E4EA6BD5_3699_47FB_837F_CB48E1D4AF97
+
+// Internal Includes
+#include "Capture.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+// - none
+
+namespace hdklogger {
+/// Discards every captured report, for runs that only publish reports to
+/// other processes or gather statistics.
+class NullWriter {
+  public:
+    void write(CapturedReport const &) {}
+
+    /// Always succeeds: there's nothing to write out.
+    bool finish() { return true; }
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_NullWriter_h_GUID_E4EA6BD5_3699_47FB_837F_CB48E1D4AF97
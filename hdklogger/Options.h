@@ -0,0 +1,512 @@
+/** @file
+    @brief Header defining the command-line options of the logger.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Options_h_GUID_25653312_48D9_4CEA_B3EF_B66E6F5B0EE7
+#define INCLUDED_Options_h_GUID_25653312_48D9_4CEA_B3EF_B66E6F5B0EE7
+
+// Internal Includes
+#include "Compression.h"
+#include "GroupCommitFile.h"
+#include "Realtime.h"
+#include "SharedRing.h"
+#include "Trace.h"
+#include "SimulatedDevice.h"
+#include "StatsServer.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace hdklogger {
+/// Formats the captured reports can be written in: or None, to not write
+/// them at all.
+enum class OutputFormat { Text, Binary, Compressed, None };
+
+/// Ways of reading from the device.
+enum class Backend {
+    /// Through HIDAPI, with whichever backend it was built with.
+    Hidapi,
+    /// Directly through the Linux hidraw device node.
+    Hidraw,
+    /// From simulated devices, without hardware.
+    Simulated,
+    /// From previously recorded binary capture files.
+    Replay
+};
+
+/// Settings controlled from the command line.
+struct Options {
+    OutputFormat format = OutputFormat::Text;
+    /// Include decoded orientation and angular velocity in text output.
+    bool decode = false;
+    /// Compressor for the compressed format.
+    Codec codec = default_codec();
+    /// When binary output is written out, and how durably.
+    GroupCommitSettings writeSettings;
+    Backend backend = Backend::Hidapi;
+    /// Output file: empty (or "-") means stdout.
+    std::string output;
+    /// How long to capture, in seconds: negative means the default (unless
+    /// limited by count or running continuously).
+    double duration = -1;
+    /// Stop after this many reports: 0 means no limit.
+    std::uint64_t count = 0;
+    /// Capture until interrupted (SIGINT/SIGTERM) rather than for a fixed
+    /// time.
+    bool continuous = false;
+    /// Seconds between periodic statistics printouts: 0 disables them.
+    double statsInterval = 10;
+    /// Scheduling, CPU affinity and memory locking for the capture threads.
+    RealtimeSettings realtime;
+    /// Serve live statistics on a Unix domain socket at this path: empty
+    /// means don't.
+    std::string statsSocket;
+    /// Publish reports to other processes through a shared-memory ring with
+    /// this name: empty means don't.
+    std::string publish;
+    /// Write a Chrome trace of the pipeline here: empty means no tracing.
+    std::string trace;
+    /// Trace events kept per thread.
+    std::size_t traceEvents = DEFAULT_TRACE_EVENTS;
+    /// Capture from every HDK tracker found, not just the last one.
+    bool all = false;
+    /// Capture from the HDK trackers with these serial numbers.
+    std::vector<std::string> serials;
+    /// Capture from the HDK trackers at these (HIDAPI) paths.
+    std::vector<std::string> paths;
+    /// Settings for the simulated backend.
+    SimulationSettings simulation;
+    /// Number of simulated devices.
+    std::size_t simulatedDevices = 1;
+    /// Binary capture files to replay.
+    std::vector<std::string> replays;
+    /// Replay speed, relative to the original timing: 0 means as fast as
+    /// possible.
+    double replaySpeed = 1;
+    /// Start replaying this many seconds into each capture.
+    double replayFrom = 0;
+};
+
+/// Longest time any option can be set to, in seconds: about 30 years, so
+/// that it still fits in nanoseconds added to the current time.
+static const double MAX_OPTION_SECONDS = 1e9;
+
+/// Capture duration used when none of --duration, --count or --continuous is
+/// given, except when replaying, which by default runs to the end.
+static const double DEFAULT_DURATION = 0.5;
+
+/// Prints command-line usage.
+inline void print_usage(const char *argv0, std::ostream &os) {
+    os << "Usage: " << argv0 << " [options]\n"
+       << "Options:\n"
+       << "  --format=text|binary|compressed|none\n"
+       << "                        Output format (default: text), or none "
+          "to not write reports\n"
+       << "  --codec=NAME          Compressor for --format=compressed: lz4, "
+          "zstd, deflate or\n"
+       << "                        none, if built in (default: "
+       << to_string(default_codec()) << ")\n"
+       << "  --decode              Add decoded orientation and angular "
+          "velocity to text output\n"
+#ifdef HDKLOGGER_HAVE_HIDRAW
+       << "  --backend=hidapi|hidraw|sim\n"
+       << "                        Read through HIDAPI (default), directly "
+          "from hidraw, or\n"
+       << "                        from simulated trackers\n"
+#else
+       << "  --backend=hidapi|sim  Read through HIDAPI (default) or from "
+          "simulated trackers\n"
+#endif
+       << "  --output=FILE         Write to FILE instead of stdout (required "
+          "for binary).\n"
+       << "                        With several devices, %s in FILE is "
+          "replaced by each\n"
+       << "                        device's serial number (added before the "
+          "extension if absent)\n"
+       << "  --all                 Capture from every HDK tracker found\n"
+       << "  --serial=SERIAL       Capture from the tracker with this serial "
+          "number (repeatable)\n"
+       << "  --path=PATH           Capture from the tracker at this path "
+          "(repeatable)\n"
+       << "  --duration=SECONDS    Capture for this long (default: "
+       << DEFAULT_DURATION << " unless --count or --continuous is given)\n"
+       << "  --count=N             Stop after N reports\n"
+       << "  --continuous          Capture until interrupted (Ctrl-C, "
+          "SIGTERM)\n"
+#ifdef HDKLOGGER_HAVE_STATS_SERVER
+       << "  --stats-socket=PATH   Serve live statistics on a Unix domain "
+          "socket at PATH,\n"
+       << "                        for hdk-logger-stat\n"
+#endif
+#ifdef HDKLOGGER_HAVE_SHARED_RING
+       << "  --publish=NAME        Publish reports in the shared memory "
+          "object NAME, for other\n"
+       << "                        processes to read (see hdk-logger-tail). "
+          "With several\n"
+       << "                        devices, NAME gets each one's serial "
+          "number as for --output\n"
+#endif
+#if HDKLOGGER_TRACING
+       << "  --trace=FILE          Trace reports through the pipeline, "
+          "writing a Chrome\n"
+       << "                        trace to FILE at exit (and on SIGUSR2)\n"
+       << "  --trace-events=N      Most recent events to keep per thread "
+          "(default:\n"
+       << "                        " << DEFAULT_TRACE_EVENTS << ", at most "
+       << MAX_TRACE_EVENTS << ")\n"
+#endif
+       << "  --stats-interval=SECONDS\n"
+       << "                        Print statistics this often while "
+          "capturing (default: 10, 0 to disable)\n"
+       << "Capture thread options:\n"
+       << "  --realtime=fifo|rr    Run the capture threads under SCHED_FIFO or "
+          "SCHED_RR\n"
+       << "  --priority=N          Their real-time priority (default: "
+       << DEFAULT_REALTIME_PRIORITY << ")\n"
+       << "  --cpus=LIST           Run them only on these CPUs, such as "
+          "0,2-3\n"
+       << "  --mlock               Lock memory, and prefault their stacks and "
+          "rings\n"
+       << "                        Each of these falls back, with a warning, "
+          "if not permitted\n"
+       << "Binary output options:\n"
+       << "  --flush-bytes=N       Write out once N bytes are buffered "
+          "(default: 1048576)\n"
+       << "  --flush-interval=SECONDS\n"
+       << "                        Write out anything buffered this long "
+          "(default: 0.1, 0 to\n"
+       << "                        wait for a full buffer)\n"
+       << "  --sync=POLICY         none (leave it to the OS, the default), "
+          "periodic (fdatasync)\n"
+       << "                        or direct (O_DIRECT), if available\n"
+       << "  --sync-interval=SECONDS\n"
+       << "                        Least time between syncs with "
+          "--sync=periodic (default: 1)\n"
+       << "Simulated backend options:\n"
+       << "  --sim-devices=N       Number of simulated trackers (default: 1)\n"
+       << "  --sim-rate=HZ         Reports per second (default: 1000)\n"
+       << "  --sim-jitter=US       Timing jitter, +/- microseconds (default: "
+          "0)\n"
+       << "  --sim-drop=P          Probability of dropping each report "
+          "(default: 0)\n"
+       << "  --sim-burst=EVERY:LEN Hold back the first LEN of every EVERY "
+          "reports, then\n"
+       << "                        deliver them at once\n"
+       << "  --sim-seed=N          Random seed for jitter and drops\n"
+       << "  --sim-fast            Deliver reports as fast as they're read\n"
+       << "Replay options:\n"
+       << "  --replay=FILE         Replay a binary capture instead of "
+          "capturing from trackers\n"
+       << "                        (repeatable)\n"
+       << "  --replay-speed=X      Replay at X times the original timing, or "
+          "0 for as fast\n"
+       << "                        as possible (default: 1)\n"
+       << "  --replay-from=SECONDS Start this far into each capture\n"
+       << "  --help                Show this message\n";
+}
+
+namespace detail {
+    /// If @p arg is `--name=value`, puts the value in @p value and returns
+    /// true.
+    inline bool match_option(const char *arg, const char *name,
+                             std::string &value) {
+        auto len = std::strlen(name);
+        if (0 != std::strncmp(arg, name, len) || arg[len] != '=') {
+            return false;
+        }
+        value = arg + len + 1;
+        return true;
+    }
+
+    /// Parses a whole string as a finite, non-negative number, returning
+    /// false if it isn't one.
+    inline bool parse_number(std::string const &value, double &out) {
+        char *end = nullptr;
+        out = std::strtod(value.c_str(), &end);
+        return !value.empty() && *end == '\0' && std::isfinite(out) &&
+               out >= 0;
+    }
+
+    /// Parses a whole string as a number of seconds, like parse_number(),
+    /// capping it at MAX_OPTION_SECONDS.
+    inline bool parse_seconds(std::string const &value, double &out) {
+        if (!parse_number(value, out)) {
+            return false;
+        }
+        out = std::min(out, MAX_OPTION_SECONDS);
+        return true;
+    }
+
+    /// @overload
+    ///
+    /// Only digits are accepted, so no sign or leading whitespace, and
+    /// numbers too large for 64 bits are rejected rather than clamped.
+    inline bool parse_number(std::string const &value, std::uint64_t &out) {
+        if (value.empty() || !std::isdigit((unsigned char)value[0])) {
+            return false;
+        }
+        char *end = nullptr;
+        errno = 0;
+        out = std::strtoull(value.c_str(), &end, 10);
+        return *end == '\0' && errno != ERANGE;
+    }
+} // namespace detail
+
+/// Parses the command line into @p opts. Returns false (having printed why to
+/// stderr) if the command line is invalid or help was requested.
+inline bool parse_options(int argc, char *argv[], Options &opts) {
+    std::string value;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (0 == std::strcmp(arg, "--help") || 0 == std::strcmp(arg, "-h")) {
+            print_usage(argv[0], std::cerr);
+            return false;
+        } else if (detail::match_option(arg, "--format", value)) {
+            if (value == "text") {
+                opts.format = OutputFormat::Text;
+            } else if (value == "binary") {
+                opts.format = OutputFormat::Binary;
+            } else if (value == "compressed") {
+                opts.format = OutputFormat::Compressed;
+            } else if (value == "none") {
+                opts.format = OutputFormat::None;
+            } else {
+                std::cerr << "Unknown output format: " << value << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--codec", value)) {
+            if (!parse_codec(value, opts.codec) ||
+                !codec_available(opts.codec)) {
+                std::cerr << "Unknown or unavailable codec: " << value
+                          << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--flush-bytes", value)) {
+            std::uint64_t n = 0;
+            if (!detail::parse_number(value, n) || n == 0) {
+                std::cerr << "Invalid flush size: " << value << "\n";
+                return false;
+            }
+            opts.writeSettings.flushBytes = std::size_t(n);
+        } else if (detail::match_option(arg, "--flush-interval", value)) {
+            double seconds = 0;
+            if (!detail::parse_seconds(value, seconds)) {
+                std::cerr << "Invalid flush interval: " << value << "\n";
+                return false;
+            }
+            opts.writeSettings.flushInterval = std::int64_t(seconds * 1e9);
+        } else if (detail::match_option(arg, "--sync", value)) {
+            if (!parse_sync_policy(value, opts.writeSettings.sync) ||
+                !sync_policy_available(opts.writeSettings.sync)) {
+                std::cerr << "Unknown or unavailable sync policy: " << value
+                          << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--sync-interval", value)) {
+            double seconds = 0;
+            if (!detail::parse_seconds(value, seconds)) {
+                std::cerr << "Invalid sync interval: " << value << "\n";
+                return false;
+            }
+            opts.writeSettings.syncInterval = std::int64_t(seconds * 1e9);
+        } else if (0 == std::strcmp(arg, "--decode")) {
+            opts.decode = true;
+        } else if (detail::match_option(arg, "--backend", value)) {
+            if (value == "hidapi") {
+                opts.backend = Backend::Hidapi;
+#ifdef HDKLOGGER_HAVE_HIDRAW
+            } else if (value == "hidraw") {
+                opts.backend = Backend::Hidraw;
+#endif
+            } else if (value == "sim") {
+                opts.backend = Backend::Simulated;
+            } else {
+                std::cerr << "Unknown or unavailable backend: " << value
+                          << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--output", value)) {
+            opts.output = value;
+        } else if (detail::match_option(arg, "--duration", value)) {
+            if (!detail::parse_seconds(value, opts.duration)) {
+                std::cerr << "Invalid duration: " << value << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--count", value)) {
+            if (!detail::parse_number(value, opts.count)) {
+                std::cerr << "Invalid count: " << value << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--stats-interval", value)) {
+            if (!detail::parse_seconds(value, opts.statsInterval)) {
+                std::cerr << "Invalid statistics interval: " << value << "\n";
+                return false;
+            }
+#ifdef HDKLOGGER_HAVE_STATS_SERVER
+        } else if (detail::match_option(arg, "--stats-socket", value)) {
+            opts.statsSocket = value;
+#endif
+#ifdef HDKLOGGER_HAVE_SHARED_RING
+        } else if (detail::match_option(arg, "--publish", value)) {
+            if (value.empty() ||
+                value.find('/', value[0] == '/' ? 1 : 0) !=
+                    std::string::npos) {
+                std::cerr << "Invalid shared memory name: " << value << "\n";
+                return false;
+            }
+            opts.publish = value;
+#endif
+#if HDKLOGGER_TRACING
+        } else if (detail::match_option(arg, "--trace", value)) {
+            opts.trace = value;
+        } else if (detail::match_option(arg, "--trace-events", value)) {
+            std::uint64_t n = 0;
+            if (!detail::parse_number(value, n) || n == 0 ||
+                n > MAX_TRACE_EVENTS) {
+                std::cerr << "Invalid number of trace events: " << value
+                          << "\n";
+                return false;
+            }
+            opts.traceEvents = std::size_t(n);
+#endif
+        } else if (detail::match_option(arg, "--realtime", value)) {
+            if (!parse_scheduling_policy(value, opts.realtime.policy)) {
+                std::cerr << "Unknown scheduling policy: " << value << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--priority", value)) {
+            std::uint64_t priority = 0;
+            if (!detail::parse_number(value, priority) || priority > 1000) {
+                std::cerr << "Invalid priority: " << value << "\n";
+                return false;
+            }
+            opts.realtime.priority = int(priority);
+        } else if (detail::match_option(arg, "--cpus", value)) {
+            if (!parse_cpu_list(value, opts.realtime.cpus)) {
+                std::cerr << "Invalid CPU list: " << value << "\n";
+                return false;
+            }
+        } else if (0 == std::strcmp(arg, "--mlock")) {
+            opts.realtime.lockMemory = true;
+        } else if (0 == std::strcmp(arg, "--all")) {
+            opts.all = true;
+        } else if (detail::match_option(arg, "--serial", value)) {
+            opts.serials.push_back(value);
+        } else if (detail::match_option(arg, "--path", value)) {
+            opts.paths.push_back(value);
+        } else if (detail::match_option(arg, "--sim-devices", value)) {
+            std::uint64_t n = 0;
+            if (!detail::parse_number(value, n) || n == 0) {
+                std::cerr << "Invalid number of devices: " << value << "\n";
+                return false;
+            }
+            opts.simulatedDevices = std::size_t(n);
+        } else if (detail::match_option(arg, "--sim-rate", value)) {
+            if (!detail::parse_number(value, opts.simulation.rate) ||
+                opts.simulation.rate <= 0) {
+                std::cerr << "Invalid rate: " << value << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--sim-jitter", value)) {
+            if (!detail::parse_number(value, opts.simulation.jitter)) {
+                std::cerr << "Invalid jitter: " << value << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--sim-drop", value)) {
+            if (!detail::parse_number(value, opts.simulation.dropProbability) ||
+                opts.simulation.dropProbability > 1) {
+                std::cerr << "Invalid drop probability: " << value << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--sim-burst", value)) {
+            auto colon = value.find(':');
+            std::uint64_t every = 0;
+            std::uint64_t len = 0;
+            if (colon == std::string::npos ||
+                !detail::parse_number(value.substr(0, colon), every) ||
+                !detail::parse_number(value.substr(colon + 1), len) ||
+                len > every) {
+                std::cerr << "Invalid burst pattern: " << value << "\n";
+                return false;
+            }
+            opts.simulation.burstEvery = std::size_t(every);
+            opts.simulation.burstLength = std::size_t(len);
+        } else if (detail::match_option(arg, "--sim-seed", value)) {
+            if (!detail::parse_number(value, opts.simulation.seed)) {
+                std::cerr << "Invalid seed: " << value << "\n";
+                return false;
+            }
+        } else if (0 == std::strcmp(arg, "--sim-fast")) {
+            opts.simulation.realtime = false;
+        } else if (detail::match_option(arg, "--replay", value)) {
+            opts.backend = Backend::Replay;
+            opts.replays.push_back(value);
+        } else if (detail::match_option(arg, "--replay-speed", value)) {
+            if (!detail::parse_number(value, opts.replaySpeed)) {
+                std::cerr << "Invalid replay speed: " << value << "\n";
+                return false;
+            }
+        } else if (detail::match_option(arg, "--replay-from", value)) {
+            if (!detail::parse_seconds(value, opts.replayFrom)) {
+                std::cerr << "Invalid replay start: " << value << "\n";
+                return false;
+            }
+        } else if (0 == std::strcmp(arg, "--continuous")) {
+            opts.continuous = true;
+        } else {
+            std::cerr << "Unrecognized argument: " << arg << "\n";
+            print_usage(argv[0], std::cerr);
+            return false;
+        }
+    }
+    if (opts.continuous && opts.duration >= 0) {
+        std::cerr << "--continuous and --duration can't be combined\n";
+        return false;
+    }
+    if (opts.duration < 0 && opts.count == 0 && !opts.continuous &&
+        opts.backend != Backend::Replay) {
+        opts.duration = DEFAULT_DURATION;
+    }
+    if ((opts.format == OutputFormat::Binary ||
+         opts.format == OutputFormat::Compressed) &&
+        (opts.output.empty() || opts.output == "-")) {
+        std::cerr << "Binary output needs an output file: use --output=FILE\n";
+        return false;
+    }
+    return true;
+}
+} // namespace hdklogger
+
+#endif // INCLUDED_Options_h_GUID_25653312_48D9_4CEA_B3EF_B66E6F5B0EE7
@@ -0,0 +1,315 @@
+/** @file
+    @brief Header with utilities to give the capture threads real-time
+    scheduling, pin them to CPUs, and keep their memory resident.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Realtime_h_GUID_BDC5EDBD_44E2_466D_8B6B_95769962E52E
+#define INCLUDED_Realtime_h_GUID_BDC5EDBD_44E2_466D_8B6B_95769962E52E
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <cerrno>
+#include <cstddef> // for std::size_t
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HDKLOGGER_HAVE_POSIX_REALTIME
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace hdklogger {
+/// Scheduling policies a capture thread can run under.
+enum class SchedulingPolicy {
+    /// Whatever the thread was started with: the usual time-sharing one.
+    Normal,
+    /// SCHED_FIFO: runs until it blocks or something of higher priority is
+    /// ready.
+    Fifo,
+    /// SCHED_RR: like SCHED_FIFO, but round-robin among threads of equal
+    /// priority.
+    RoundRobin
+};
+
+inline const char *to_string(SchedulingPolicy policy) {
+    switch (policy) {
+    case SchedulingPolicy::Normal:
+        return "normal";
+    case SchedulingPolicy::Fifo:
+        return "fifo";
+    case SchedulingPolicy::RoundRobin:
+        return "rr";
+    }
+    return "unknown";
+}
+
+/// Parses a scheduling policy name, as produced by to_string(). Returns false
+/// if it is not one.
+inline bool parse_scheduling_policy(std::string const &name,
+                                    SchedulingPolicy &policy) {
+    for (auto candidate : {SchedulingPolicy::Normal, SchedulingPolicy::Fifo,
+                           SchedulingPolicy::RoundRobin}) {
+        if (name == to_string(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Real-time priority used unless another is given: in the middle of the
+/// range, above most kernel threads that matter but below the watchdogs.
+static const int DEFAULT_REALTIME_PRIORITY = 50;
+
+/// How much of a thread's stack prefault_stack() touches by default.
+static const std::size_t STACK_PREFAULT_BYTES = 256 * 1024;
+
+/// How the capture threads should be run.
+struct RealtimeSettings {
+    SchedulingPolicy policy = SchedulingPolicy::Normal;
+    /// Priority under the Fifo and RoundRobin policies.
+    int priority = DEFAULT_REALTIME_PRIORITY;
+    /// CPUs the capture threads may run on: empty means any.
+    std::vector<int> cpus;
+    /// Lock the process's memory, and prefault the capture threads' stacks
+    /// and rings.
+    bool lockMemory = false;
+};
+
+/// Parses a list of CPUs such as "0,2-3". Returns false if it is not one.
+inline bool parse_cpu_list(std::string const &list, std::vector<int> &cpus) {
+    std::vector<int> ret;
+    std::size_t pos = 0;
+    while (pos <= list.size()) {
+        auto comma = list.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        auto item = list.substr(pos, comma - pos);
+        auto dash = item.find('-');
+        char *end = nullptr;
+        auto first = std::strtol(item.c_str(), &end, 10);
+        auto last = first;
+        if (item.empty() || end == item.c_str() || first < 0) {
+            return false;
+        }
+        if (dash != std::string::npos) {
+            if (end != item.c_str() + dash) {
+                return false;
+            }
+            auto rest = item.c_str() + dash + 1;
+            last = std::strtol(rest, &end, 10);
+            if (end == rest || last < first) {
+                return false;
+            }
+        }
+        if (*end != '\0') {
+            return false;
+        }
+        for (auto cpu = first; cpu <= last; ++cpu) {
+            ret.push_back(int(cpu));
+        }
+        pos = comma + 1;
+    }
+    cpus.swap(ret);
+    return true;
+}
+
+/// Switches the calling thread to the given scheduling policy and priority.
+/// Returns false, with the reason in @p error, if it can't be (usually for
+/// want of CAP_SYS_NICE or an RLIMIT_RTPRIO allowance).
+inline bool set_thread_scheduling(SchedulingPolicy policy, int priority,
+                                  std::string &error) {
+    if (policy == SchedulingPolicy::Normal) {
+        return true;
+    }
+#ifdef HDKLOGGER_HAVE_POSIX_REALTIME
+    auto native = policy == SchedulingPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+    auto lowest = sched_get_priority_min(native);
+    auto highest = sched_get_priority_max(native);
+    if (priority < lowest || priority > highest) {
+        error = "priority " + std::to_string(priority) +
+                " is outside the range " + std::to_string(lowest) + "-" +
+                std::to_string(highest);
+        return false;
+    }
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    auto ret = pthread_setschedparam(pthread_self(), native, &param);
+    if (ret != 0) {
+        error = std::strerror(ret);
+        return false;
+    }
+    return true;
+#else
+    (void)priority;
+    error = "not supported on this platform";
+    return false;
+#endif
+}
+
+/// Restricts the calling thread to the given CPUs (any, if empty). Returns
+/// false, with the reason in @p error, if it can't be.
+inline bool set_thread_affinity(std::vector<int> const &cpus,
+                                std::string &error) {
+    if (cpus.empty()) {
+        return true;
+    }
+#if defined(HDKLOGGER_HAVE_POSIX_REALTIME) && defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) {
+            error = "CPU " + std::to_string(cpu) + " is out of range";
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    auto ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        error = std::strerror(ret);
+        return false;
+    }
+    return true;
+#else
+    error = "not supported on this platform";
+    return false;
+#endif
+}
+
+#ifdef HDKLOGGER_HAVE_POSIX_REALTIME
+namespace detail {
+    /// Does the process have CAP_IPC_LOCK in its effective set, so that the
+    /// locked-memory limit doesn't apply to it? Only Linux is checked.
+    inline bool can_lock_past_limit() {
+#ifdef __linux__
+        /// CAP_IPC_LOCK, from <linux/capability.h>.
+        static const unsigned CAP_IPC_LOCK_BIT = 14;
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, 7, "CapEff:") == 0) {
+                auto caps = std::strtoull(line.c_str() + 7, nullptr, 16);
+                return (caps >> CAP_IPC_LOCK_BIT) & 1;
+            }
+        }
+#endif
+        return false;
+    }
+} // namespace detail
+#endif
+
+/// Locks all the process's memory, current and future, into RAM, so that
+/// the capture threads never wait on a page being swapped in. Returns false,
+/// with the reason in @p error, if it can't be.
+///
+/// Only attempted when the locked-memory limit is unlimited, or doesn't
+/// apply because we are root or have CAP_IPC_LOCK: with a limit, later
+/// allocations (such as new threads' stacks) could fail once it was reached.
+inline bool lock_memory(std::string &error) {
+#ifdef HDKLOGGER_HAVE_POSIX_REALTIME
+    rlimit limit;
+    if (geteuid() != 0 && !detail::can_lock_past_limit() &&
+        (0 != getrlimit(RLIMIT_MEMLOCK, &limit) ||
+         limit.rlim_cur != RLIM_INFINITY)) {
+        error = "the locked-memory limit (ulimit -l) is not unlimited, and "
+                "CAP_IPC_LOCK is not held";
+        return false;
+    }
+    if (0 != mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        error = std::strerror(errno);
+        return false;
+    }
+    return true;
+#else
+    error = "not supported on this platform";
+    return false;
+#endif
+}
+
+namespace detail {
+    /// Not inlined, so the array really is on the stack below the caller's
+    /// frame.
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((noinline))
+#elif defined(_MSC_VER)
+    __declspec(noinline)
+#endif
+    inline void
+    touch_stack(std::size_t bytes) {
+        static const std::size_t CHUNK = 16 * 1024;
+        volatile char buffer[CHUNK];
+        for (std::size_t i = 0; i < CHUNK; i += 512) {
+            buffer[i] = 0;
+        }
+        if (bytes > CHUNK) {
+            touch_stack(bytes - CHUNK);
+        }
+        /// Keeps this from being turned into a loop.
+        buffer[0] = buffer[CHUNK - 1];
+    }
+} // namespace detail
+
+/// Touches the next @p bytes of the calling thread's stack, so that using it
+/// later doesn't take page faults.
+inline void prefault_stack(std::size_t bytes = STACK_PREFAULT_BYTES) {
+    detail::touch_stack(bytes);
+}
+
+/// Applies the scheduling, affinity and stack prefaulting of @p settings to
+/// the calling thread. Returns a message for each that couldn't be applied:
+/// the thread carries on without it.
+inline std::vector<std::string>
+apply_to_current_thread(RealtimeSettings const &settings) {
+    std::vector<std::string> failures;
+    std::string error;
+    if (!set_thread_scheduling(settings.policy, settings.priority, error)) {
+        failures.push_back(std::string("can't use ") +
+                           to_string(settings.policy) + " scheduling: " +
+                           error);
+    }
+    error.clear();
+    if (!set_thread_affinity(settings.cpus, error)) {
+        failures.push_back("can't set CPU affinity: " + error);
+    }
+    if (settings.lockMemory) {
+        prefault_stack();
+    }
+    return failures;
+}
+} // namespace hdklogger
+
+#endif // INCLUDED_Realtime_h_GUID_BDC5EDBD_44E2_466D_8B6B_95769962E52E
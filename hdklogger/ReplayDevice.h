@@ -0,0 +1,341 @@
+/** @file
+    @brief Header defining a device replaying a binary capture file, to feed
+   recorded reports back through the capture pipeline.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_ReplayDevice_h_GUID_FB9B04B8_E888_4374_A3AB_2906B6B490EB
+#define INCLUDED_ReplayDevice_h_GUID_FB9B04B8_E888_4374_A3AB_2906B6B490EB
+
+// Internal Includes
+#include "BinaryFormat.h"
+#include "Clock.h"
+#include "DeviceInfo.h"
+#include "FileOffset.h"
+
+// Library/third-party includes
+#include "hidapipp/Device.h"
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace hdklogger {
+/// Replay speed meaning "as fast as the reports can be read".
+static const double REPLAY_AS_FAST_AS_POSSIBLE = 0;
+
+/// Number of records read from the file at a time.
+static const std::size_t REPLAY_CHUNK_RECORDS = 256;
+
+/// A device returning the reports recorded in a binary capture file, at
+/// their original timing, sped up or slowed down, or as fast as they are
+/// read. Each report's recorded timestamp is available from timestamp(),
+/// and is what the capture pipeline records for it (see report_timestamp()).
+///
+/// Reading past the last whole record fails, with at_end() then true. A
+/// truncated final record, as left by a capture that was cut short, is
+/// ignored. seek() skips to a given time, using the capture's time index if
+/// it has one.
+///
+/// Most functionality provided by hidapi::DeviceBase.
+class ReplayDevice : public hidapi::DeviceBase<ReplayDevice> {
+  public:
+    using base = hidapi::DeviceBase<ReplayDevice>;
+    /// Default, empty constructor. Not very useful on its own, mostly for move
+    /// assignment.
+    ReplayDevice() : base() {}
+
+    /// Constructor: opens a capture file for replay at @p speed times its
+    /// original timing (REPLAY_AS_FAST_AS_POSSIBLE for no waiting at all).
+    /// Timing starts with the first read. Throws std::runtime_error if the
+    /// file cannot be opened or is not a capture file.
+    explicit ReplayDevice(std::string const &path, double speed = 1)
+        : base(), path_(path), file_(std::fopen(path.c_str(), "rb")),
+          speed_(speed),
+          buffer_(new std::uint8_t[REPLAY_CHUNK_RECORDS *
+                                   binary::RECORD_SIZE]) {
+        if (!file_) {
+            throw std::runtime_error("Could not open capture file " + path);
+        }
+        std::uint8_t header[binary::HEADER_SIZE];
+        if (std::fread(header, 1, sizeof(header), file_.get()) !=
+                sizeof(header) ||
+            !binary::decode_header(header, sizeof(header), header_)) {
+            throw std::runtime_error(path + " is not a capture file");
+        }
+        auto size = file_size(file_.get());
+        if (size < 0) {
+            throw std::runtime_error("Could not get the size of capture file " +
+                                     path);
+        }
+        auto end = binary::records_end(header_, std::uint64_t(size));
+        records_ = (end - binary::HEADER_SIZE) / binary::RECORD_SIZE;
+        std::uint8_t index[binary::INDEX_HEADER_SIZE];
+        std::uint32_t interval = 0;
+        if (header_.indexOffset &&
+            file_seek(file_.get(), header_.indexOffset) &&
+            std::fread(index, 1, sizeof(index), file_.get()) == sizeof(index) &&
+            binary::decode_index_header(
+                index, std::size_t(std::uint64_t(size) - header_.indexOffset),
+                interval, indexEntries_)) {
+            indexOffset_ = header_.indexOffset;
+        } else {
+            indexEntries_ = 0;
+        }
+        if (records_) {
+            startTimestamp_ = read_timestamp_(0);
+        }
+        reposition_(0);
+    }
+
+    ReplayDevice(ReplayDevice &&) = default;
+    ReplayDevice &operator=(ReplayDevice &&) = default;
+    /// Not copy constructible
+    ReplayDevice(ReplayDevice const &) = delete;
+    /// Not copy assignable
+    ReplayDevice &operator=(ReplayDevice const &) = delete;
+
+    /// Not backed by a HIDAPI device.
+    hid_device *get() const { return nullptr; }
+
+    /// Sets whether read() waits for a report to be due (the default) or
+    /// returns immediately, like `hid_set_nonblocking()`.
+    void set_nonblocking(bool nonblocking) { nonblocking_ = nonblocking; }
+
+    /// The capture file's header.
+    binary::Header const &header() const { return header_; }
+
+    /// Describes the device the capture was recorded from, with the capture
+    /// file as its path.
+    DeviceInfo info() const {
+        DeviceInfo ret;
+        ret.path = path_;
+        ret.vendorId = header_.vendorId;
+        ret.productId = header_.productId;
+        ret.releaseNumber = header_.releaseNumber;
+        ret.serialNumber = header_.serialNumber;
+        return ret;
+    }
+
+    /// Recorded timestamp of the report most recently read.
+    std::int64_t timestamp() const { return timestamp_; }
+
+    /// Reports replayed so far.
+    std::uint64_t replayed() const { return replayed_; }
+
+    /// Has the whole capture been replayed?
+    bool at_end() const { return atEnd_; }
+
+    /// Number of (whole) records in the capture.
+    std::uint64_t records() const { return records_; }
+
+    /// Recorded timestamp of the first record, or 0 if there are none.
+    std::int64_t start_timestamp() const { return startTimestamp_; }
+
+    /// Continues the replay from the first record with a timestamp of at
+    /// least @p timestamp, in O(log n) reads, returning its number (records()
+    /// if there is none). Timing restarts with the next read.
+    std::uint64_t seek(std::int64_t timestamp) {
+        auto record = binary::find_record(
+            timestamp, records_,
+            [&](std::uint64_t i) { return read_timestamp_(i); },
+            indexEntries_, [&](std::uint64_t k) { return read_entry_(k); });
+        reposition_(record);
+        return record;
+    }
+
+  private:
+    friend class hidapi::DeviceBase<ReplayDevice>;
+
+    bool valid_impl() const { return bool(file_); }
+
+    int read_impl(hidapi::DataByte *buf, std::size_t maxLength) {
+        return read_timeout_impl(buf, maxLength, nonblocking_ ? 0 : -1);
+    }
+
+    int read_timeout_impl(hidapi::DataByte *buf, std::size_t maxLength,
+                          int milliseconds) {
+        if (!pending_ && !next_record_()) {
+            return -1;
+        }
+        auto recorded = binary::record_timestamp(pending_);
+        if (speed_ > 0) {
+            if (!started_) {
+                started_ = true;
+                startReplay_ = monotonic_now();
+                startRecorded_ = recorded;
+            }
+            auto due = std::int64_t(double(recorded - startRecorded_) / speed_);
+            auto wait = due - (monotonic_now() - startReplay_);
+            if (wait > 0) {
+                if (milliseconds == 0) {
+                    return 0;
+                }
+                if (milliseconds > 0 &&
+                    wait > std::int64_t(milliseconds) * 1000000) {
+                    std::this_thread::sleep_for(
+                        std::chrono::milliseconds(milliseconds));
+                    return 0;
+                }
+                std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+            }
+        }
+        auto len = std::min(maxLength, binary::record_length(pending_));
+        std::memcpy(buf, binary::record_data(pending_), len);
+        timestamp_ = recorded;
+        pending_ = nullptr;
+        ++replayed_;
+        return static_cast<int>(len);
+    }
+
+    int get_feature_report_impl(hidapi::DataByte *, std::size_t) {
+        return -1;
+    }
+
+    const wchar_t *error_impl() {
+        if (atEnd_) {
+            return L"End of replayed capture";
+        }
+        if (readError_) {
+            return L"Error reading capture file";
+        }
+        return L"Not supported by the replay device";
+    }
+
+    /// Points pending_ at the next record, reading another chunk of the file
+    /// if needed. Returns false at the end of the records.
+    bool next_record_() {
+        if (next_ == buffered_) {
+            if (atEnd_ || readError_) {
+                return false;
+            }
+            auto wanted = std::size_t(std::min<std::uint64_t>(
+                REPLAY_CHUNK_RECORDS, records_ - position_));
+            buffered_ = wanted ? std::fread(buffer_.get(), binary::RECORD_SIZE,
+                                            wanted, file_.get())
+                               : 0;
+            next_ = 0;
+            position_ += buffered_;
+            if (buffered_ == 0) {
+                readError_ = wanted && 0 != std::ferror(file_.get());
+                atEnd_ = !readError_;
+                return false;
+            }
+        }
+        pending_ = buffer_.get() + next_ * binary::RECORD_SIZE;
+        ++next_;
+        return true;
+    }
+
+    /// Moves the file position to a record, discarding what was buffered.
+    void reposition_(std::uint64_t record) {
+        position_ = std::min(record, records_);
+        auto ok = file_seek(file_.get(), binary::HEADER_SIZE +
+                                             position_ * binary::RECORD_SIZE);
+        buffered_ = next_ = 0;
+        pending_ = nullptr;
+        started_ = false;
+        atEnd_ = false;
+        /// Reported by the next read.
+        readError_ = !ok;
+    }
+
+    /// @name Random access for seeking
+    /// @brief Leave the file position anywhere: follow with reposition_().
+    /// @{
+    std::int64_t read_timestamp_(std::uint64_t record) {
+        std::uint8_t field[8] = {0};
+        if (!file_seek(file_.get(),
+                       binary::HEADER_SIZE + record * binary::RECORD_SIZE) ||
+            std::fread(field, 1, sizeof(field), file_.get()) != sizeof(field)) {
+            return 0;
+        }
+        return std::int64_t(binary::load_u64(field));
+    }
+    binary::IndexEntry read_entry_(std::uint64_t k) {
+        std::uint8_t entry[binary::INDEX_ENTRY_SIZE] = {0};
+        if (!file_seek(file_.get(), indexOffset_ + binary::INDEX_HEADER_SIZE +
+                                        k * binary::INDEX_ENTRY_SIZE) ||
+            std::fread(entry, 1, sizeof(entry), file_.get()) != sizeof(entry)) {
+            return binary::IndexEntry{0, 0};
+        }
+        return binary::decode_index_entry(entry);
+    }
+    /// @}
+
+    struct FileCloser {
+        void operator()(std::FILE *f) { std::fclose(f); }
+    };
+    std::string path_;
+    std::unique_ptr<std::FILE, FileCloser> file_;
+    binary::Header header_;
+    double speed_ = 1;
+    bool nonblocking_ = false;
+    std::unique_ptr<std::uint8_t[]> buffer_;
+    /// Records in the buffer, and the index of the next one to replay.
+    std::size_t buffered_ = 0;
+    std::size_t next_ = 0;
+    /// The record to be returned by the next read, if already read from the
+    /// file.
+    std::uint8_t const *pending_ = nullptr;
+    bool started_ = false;
+    std::int64_t startReplay_ = 0;
+    std::int64_t startRecorded_ = 0;
+    std::int64_t timestamp_ = 0;
+    std::uint64_t replayed_ = 0;
+    bool atEnd_ = false;
+    bool readError_ = false;
+    std::uint64_t records_ = 0;
+    /// Number of the next record to be read from the file.
+    std::uint64_t position_ = 0;
+    std::int64_t startTimestamp_ = 0;
+    std::uint64_t indexOffset_ = 0;
+    std::uint64_t indexEntries_ = 0;
+};
+
+/// @name Capture pipeline customization points
+/// @{
+/// Replayed reports keep their recorded timestamps.
+inline std::int64_t report_timestamp(ReplayDevice const &dev) {
+    return dev.timestamp();
+}
+/// Replayed timestamps are related to wall-clock time by the capture's
+/// anchor.
+inline ClockAnchor clock_anchor(ReplayDevice const &dev) {
+    return dev.header().anchor;
+}
+/// The end of the capture is the end of the stream, not an error.
+inline bool end_of_stream(ReplayDevice const &dev) { return dev.at_end(); }
+/// Nothing is lost by waiting, so replay never drops reports.
+inline bool can_wait_for_ring(ReplayDevice const &) { return true; }
+/// @}
+} // namespace hdklogger
+
+#endif // INCLUDED_ReplayDevice_h_GUID_FB9B04B8_E888_4374_A3AB_2906B6B490EB
@@ -0,0 +1,314 @@
+/** @file
+    @brief Header with a columnar, chunked in-memory store of decoded
+   tracker samples, for analysis.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_SampleStore_h_GUID_C8F62ED6_6EE2_4F87_A97B_9914DAA1036B
+#define INCLUDED_SampleStore_h_GUID_C8F62ED6_6EE2_4F87_A97B_9914DAA1036B
+
+// Internal Includes
+#include "BatchDecoder.h"
+#include "BinaryFormat.h"
+#include "Capture.h"
+#include "Decoder.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <algorithm>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace hdklogger {
+/// Number of samples per chunk of a ChunkedColumn, as a power of two.
+static const std::size_t SAMPLE_CHUNK_SHIFT = 16;
+static const std::size_t SAMPLE_CHUNK_SIZE = std::size_t(1)
+                                             << SAMPLE_CHUNK_SHIFT;
+
+/// A column of values stored in fixed-size chunks, so that growing it never
+/// moves (or copies) what is already there: pointers into it stay valid
+/// until it is cleared.
+template <typename T> class ChunkedColumn {
+  public:
+    ChunkedColumn() = default;
+    ChunkedColumn(ChunkedColumn &&) = default;
+    ChunkedColumn &operator=(ChunkedColumn &&) = default;
+    ChunkedColumn(ChunkedColumn const &) = delete;
+    ChunkedColumn &operator=(ChunkedColumn const &) = delete;
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T const &operator[](std::size_t i) const {
+        return chunks_[i >> SAMPLE_CHUNK_SHIFT]
+                      [i & (SAMPLE_CHUNK_SIZE - 1)];
+    }
+
+    /// @name Chunk access
+    /// @brief For going through a column a contiguous array at a time.
+    /// @{
+    std::size_t chunk_count() const {
+        return (size_ + SAMPLE_CHUNK_SIZE - 1) >> SAMPLE_CHUNK_SHIFT;
+    }
+    T const *chunk(std::size_t c) const { return chunks_[c].get(); }
+    std::size_t chunk_size(std::size_t c) const {
+        return std::min(SAMPLE_CHUNK_SIZE, size_ - c * SAMPLE_CHUNK_SIZE);
+    }
+    /// @}
+
+    void push_back(T const &val) {
+        std::size_t room;
+        *tail(room) = val;
+        ++size_;
+    }
+
+    /// Returns where the next value goes, setting @p room to how many can be
+    /// written there contiguously (at least 1): allocates a chunk if needed.
+    /// Follow with extend() to add what was written.
+    T *tail(std::size_t &room) {
+        auto offset = size_ & (SAMPLE_CHUNK_SIZE - 1);
+        if (offset == 0 && chunk_count() == chunks_.size()) {
+            chunks_.emplace_back(new T[SAMPLE_CHUNK_SIZE]);
+        }
+        room = SAMPLE_CHUNK_SIZE - offset;
+        return chunks_[size_ >> SAMPLE_CHUNK_SHIFT].get() + offset;
+    }
+
+    /// Adds @p n values written at tail().
+    void extend(std::size_t n) { size_ += n; }
+
+    /// Empties the column, keeping its chunks for reuse.
+    void clear() { size_ = 0; }
+
+  private:
+    std::vector<std::unique_ptr<T[]>> chunks_;
+    std::size_t size_ = 0;
+};
+
+/// Decoded tracker samples in structure-of-arrays form: a ChunkedColumn per
+/// field, so analysis can run over a single field (say, orientation.w of a
+/// million samples) touching nothing else, and read it in place.
+///
+/// Not thread-safe: append from one thread (such as a capture pipeline's
+/// output thread, through SampleStoreSink), and read once appending is done
+/// or from that same thread.
+class SampleStore {
+  public:
+    SampleStore() = default;
+    SampleStore(SampleStore const &) = delete;
+    SampleStore &operator=(SampleStore const &) = delete;
+
+    std::size_t size() const { return timestamps_.size(); }
+    bool empty() const { return timestamps_.empty(); }
+
+    /// @name Columns
+    /// @brief Field meanings as in Sample. The orientation and incremental
+    /// rotation are split into their components.
+    /// @{
+    ChunkedColumn<std::int64_t> const &timestamps() const {
+        return timestamps_;
+    }
+    ChunkedColumn<std::uint8_t> const &versions() const { return versions_; }
+    ChunkedColumn<std::uint8_t> const &flags() const { return flags_; }
+    ChunkedColumn<std::uint8_t> const &sequences() const {
+        return sequences_;
+    }
+    /// Nonzero for samples with angular velocity.
+    ChunkedColumn<std::uint8_t> const &has_angular_velocity() const {
+        return hasAngularVelocity_;
+    }
+    ChunkedColumn<float> const &w() const { return w_; }
+    ChunkedColumn<float> const &x() const { return x_; }
+    ChunkedColumn<float> const &y() const { return y_; }
+    ChunkedColumn<float> const &z() const { return z_; }
+    ChunkedColumn<float> const &vx() const { return vx_; }
+    ChunkedColumn<float> const &vy() const { return vy_; }
+    ChunkedColumn<float> const &vz() const { return vz_; }
+    /// @}
+
+    /// Reassembles one sample.
+    Sample operator[](std::size_t i) const {
+        Sample ret;
+        ret.timestamp = timestamps_[i];
+        ret.version = versions_[i];
+        ret.flags = flags_[i];
+        ret.sequence = sequences_[i];
+        ret.hasAngularVelocity = hasAngularVelocity_[i] != 0;
+        ret.orientation.w = w_[i];
+        ret.orientation.x = x_[i];
+        ret.orientation.y = y_[i];
+        ret.orientation.z = z_[i];
+        ret.incrementalRotation.x = vx_[i];
+        ret.incrementalRotation.y = vy_[i];
+        ret.incrementalRotation.z = vz_[i];
+        return ret;
+    }
+
+    void append(Sample const &sample) {
+        timestamps_.push_back(sample.timestamp);
+        versions_.push_back(sample.version);
+        flags_.push_back(sample.flags);
+        sequences_.push_back(sample.sequence);
+        hasAngularVelocity_.push_back(sample.hasAngularVelocity ? 1 : 0);
+        w_.push_back(sample.orientation.w);
+        x_.push_back(sample.orientation.x);
+        y_.push_back(sample.orientation.y);
+        z_.push_back(sample.orientation.z);
+        vx_.push_back(sample.incrementalRotation.x);
+        vy_.push_back(sample.incrementalRotation.y);
+        vz_.push_back(sample.incrementalRotation.z);
+    }
+
+    /// Decodes and appends a report, returning false (and appending nothing)
+    /// if decode() rejects it.
+    bool append(CapturedReport const &captured) {
+        Sample sample;
+        if (!decode(captured, sample)) {
+            return false;
+        }
+        append(sample);
+        return true;
+    }
+
+    /// Decodes and appends @p count consecutive binary capture records,
+    /// returning how many were appended: those decode_record() rejects are
+    /// skipped. The floats are batch-decoded straight into the columns.
+    std::size_t append_records(std::uint8_t const *records, std::size_t count,
+                               DecodeKernel kernel = best_decode_kernel()) {
+        std::size_t appended = 0;
+        while (count) {
+            std::size_t room;
+            SampleColumns out;
+            out.w = w_.tail(room);
+            out.x = x_.tail(room);
+            out.y = y_.tail(room);
+            out.z = z_.tail(room);
+            out.vx = vx_.tail(room);
+            out.vy = vy_.tail(room);
+            out.vz = vz_.tail(room);
+            auto timestamps = timestamps_.tail(room);
+            auto versions = versions_.tail(room);
+            auto flags = flags_.tail(room);
+            auto sequences = sequences_.tail(room);
+            auto hasVelocity = hasAngularVelocity_.tail(room);
+            /// All columns have the same length, so the same room.
+            auto n = std::min(room, count);
+            decode_records(records, n, out, kernel);
+            /// Fill in the rest, moving samples down over any rejected ones.
+            std::size_t kept = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                auto record = records + i * binary::RECORD_SIZE;
+                ReportView report{binary::record_data(record),
+                                  binary::record_length(record)};
+                if (!report.has_orientation()) {
+                    continue;
+                }
+                timestamps[kept] = binary::record_timestamp(record);
+                versions[kept] = report.version();
+                flags[kept] = report.flags();
+                sequences[kept] = report.sequence();
+                hasVelocity[kept] = report.has_angular_velocity() ? 1 : 0;
+                if (kept != i) {
+                    out.w[kept] = out.w[i];
+                    out.x[kept] = out.x[i];
+                    out.y[kept] = out.y[i];
+                    out.z[kept] = out.z[i];
+                    out.vx[kept] = out.vx[i];
+                    out.vy[kept] = out.vy[i];
+                    out.vz[kept] = out.vz[i];
+                }
+                ++kept;
+            }
+            extend_(kept);
+            appended += kept;
+            records += n * binary::RECORD_SIZE;
+            count -= n;
+        }
+        return appended;
+    }
+
+    /// Empties the store, keeping its memory for reuse.
+    void clear() {
+        timestamps_.clear();
+        versions_.clear();
+        flags_.clear();
+        sequences_.clear();
+        hasAngularVelocity_.clear();
+        w_.clear();
+        x_.clear();
+        y_.clear();
+        z_.clear();
+        vx_.clear();
+        vy_.clear();
+        vz_.clear();
+    }
+
+  private:
+    void extend_(std::size_t n) {
+        timestamps_.extend(n);
+        versions_.extend(n);
+        flags_.extend(n);
+        sequences_.extend(n);
+        hasAngularVelocity_.extend(n);
+        w_.extend(n);
+        x_.extend(n);
+        y_.extend(n);
+        z_.extend(n);
+        vx_.extend(n);
+        vy_.extend(n);
+        vz_.extend(n);
+    }
+
+    ChunkedColumn<std::int64_t> timestamps_;
+    ChunkedColumn<std::uint8_t> versions_;
+    ChunkedColumn<std::uint8_t> flags_;
+    ChunkedColumn<std::uint8_t> sequences_;
+    ChunkedColumn<std::uint8_t> hasAngularVelocity_;
+    ChunkedColumn<float> w_;
+    ChunkedColumn<float> x_;
+    ChunkedColumn<float> y_;
+    ChunkedColumn<float> z_;
+    ChunkedColumn<float> vx_;
+    ChunkedColumn<float> vy_;
+    ChunkedColumn<float> vz_;
+};
+
+/// Capture pipeline sink (see CaptureChannel) decoding reports into a
+/// SampleStore, which must outlive it.
+class SampleStoreSink {
+  public:
+    explicit SampleStoreSink(SampleStore &store) : store_(store) {}
+
+    void write(CapturedReport const &captured) { store_.append(captured); }
+
+    bool finish() { return true; }
+
+  private:
+    SampleStore &store_;
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_SampleStore_h_GUID_C8F62ED6_6EE2_4F87_A97B_9914DAA1036B
@@ -0,0 +1,181 @@
+/** @file
+    @brief Header defining online detection of gaps in report sequence numbers.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_SequenceTracker_h_GUID_F002A069_ADFC_46BF_A6BD_7F6469916494
+#define INCLUDED_SequenceTracker_h_GUID_F002A069_ADFC_46BF_A6BD_7F6469916494
+
+// Internal Includes
+#include "HDK.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <atomic>
+#include <cstdint>
+
+namespace hdklogger {
+/// Follows the 8-bit sequence number carried by each report, counting
+/// dropped, duplicated and reordered reports.
+///
+/// Remembers which of the last 128 sequence numbers have been seen, so a
+/// report arriving late is counted as reordered (and no longer as dropped)
+/// while a repeat is counted as a duplicate. Counters are updated by a single
+/// thread (the one calling record()) but may be read from any thread.
+///
+/// A sequence number 128 or more ahead looks just like one from the recent
+/// past, so given arrival timestamps, the time since the newest report was
+/// sent decides: a report is only taken to be from the past if too little
+/// time has passed for the device to have sent that many more. Otherwise it
+/// counts as a gap, plus as many whole wraps of the sequence number as fit
+/// in the time. Send times are estimated from the nominal period, and
+/// limited by arrival times, so a backlog read all at once after a stall is
+/// still seen as sent a period apart.
+class SequenceTracker {
+  public:
+    /// Constructor: @p period is the nominal time between reports, in the
+    /// units of the timestamps given to record().
+    explicit SequenceTracker(std::int64_t period = HDK_REPORT_PERIOD_NS) {
+        set_period(period);
+    }
+
+    /// Sets the nominal time between reports. Call before recording any.
+    void set_period(std::int64_t period) { period_ = period > 0 ? period : 1; }
+
+    /// Records the arrival of a report with the given sequence number, at
+    /// the given time: 0 if unknown, in which case every sequence number
+    /// 128 or more ahead is taken to be from the past.
+    void record(std::uint8_t seq, std::int64_t timestamp = 0) {
+        increment(received_);
+        if (!started_) {
+            started_ = true;
+            last_ = seq;
+            lastSent_ = timestamp;
+            mark(seq);
+            return;
+        }
+        /// How far ahead of the newest report this one is, modulo 256: a
+        /// repeat of it counts as a whole wrap.
+        std::uint64_t ahead = std::uint8_t(seq - last_);
+        if (ahead == 0) {
+            ahead = 256;
+        }
+        /// Reports that could have been sent since the newest one.
+        std::uint64_t elapsed = 0;
+        if (timestamp && lastSent_ && timestamp > lastSent_) {
+            elapsed =
+                std::uint64_t((timestamp - lastSent_ + period_ / 2) / period_);
+        }
+        if (ahead < 128 || 2 * elapsed > ahead) {
+            /// Moving forward, by as many whole wraps as fit in the elapsed
+            /// time: anything skipped is (for now) dropped.
+            if (elapsed > ahead) {
+                ahead += (elapsed - ahead) / 256 * 256;
+            }
+            if (ahead > 256) {
+                seen_[0] = seen_[1] = seen_[2] = seen_[3] = 0;
+            } else {
+                for (std::uint8_t skipped = std::uint8_t(last_ + 1);
+                     skipped != seq; ++skipped) {
+                    unmark(skipped);
+                }
+            }
+            if (ahead > 1) {
+                increment(dropped_, ahead - 1);
+                increment(gaps_);
+            }
+            mark(seq);
+            last_ = seq;
+            if (timestamp) {
+                /// Sent no sooner than a period (with some allowance for
+                /// a slower device clock) per report after the previous
+                /// one, and no later than it arrived.
+                auto earliest = lastSent_ + std::int64_t(ahead) *
+                                                (period_ + period_ / 16);
+                lastSent_ =
+                    lastSent_ && earliest < timestamp ? earliest : timestamp;
+            }
+        } else if (is_marked(seq)) {
+            increment(duplicated_);
+        } else {
+            /// A late arrival of one we had counted as dropped.
+            mark(seq);
+            increment(reordered_);
+            if (dropped_.load(std::memory_order_relaxed) > 0) {
+                increment(dropped_, std::uint64_t(-1));
+            }
+        }
+    }
+
+    /// @name Counters
+    /// @{
+    /// Reports recorded.
+    std::uint64_t received() const { return get(received_); }
+    /// Reports never seen, judging by skipped sequence numbers.
+    std::uint64_t dropped() const { return get(dropped_); }
+    /// Number of times one or more reports in a row were dropped.
+    std::uint64_t gaps() const { return get(gaps_); }
+    /// Reports seen more than once.
+    std::uint64_t duplicated() const { return get(duplicated_); }
+    /// Reports that arrived after a later one.
+    std::uint64_t reordered() const { return get(reordered_); }
+    /// @}
+
+  private:
+    using Counter = std::atomic<std::uint64_t>;
+    /// Single-writer increment: cheaper than an atomic read-modify-write.
+    static void increment(Counter &c, std::uint64_t n = 1) {
+        c.store(c.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+    static std::uint64_t get(Counter const &c) {
+        return c.load(std::memory_order_relaxed);
+    }
+
+    void mark(std::uint8_t seq) {
+        seen_[seq >> 6] |= (std::uint64_t(1) << (seq & 63));
+    }
+    void unmark(std::uint8_t seq) {
+        seen_[seq >> 6] &= ~(std::uint64_t(1) << (seq & 63));
+    }
+    bool is_marked(std::uint8_t seq) const {
+        return 0 != (seen_[seq >> 6] & (std::uint64_t(1) << (seq & 63)));
+    }
+
+    std::int64_t period_ = 1;
+    bool started_ = false;
+    std::uint8_t last_ = 0;
+    /// Estimated send time of the report with sequence number last_.
+    std::int64_t lastSent_ = 0;
+    /// One bit per sequence number.
+    std::uint64_t seen_[4] = {0, 0, 0, 0};
+    Counter received_{0};
+    Counter dropped_{0};
+    Counter gaps_{0};
+    Counter duplicated_{0};
+    Counter reordered_{0};
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_SequenceTracker_h_GUID_F002A069_ADFC_46BF_A6BD_7F6469916494
@@ -0,0 +1,454 @@
+/** @file
+    @brief Header publishing captured reports to other processes through a
+    shared-memory seqlock ring.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_SharedRing_h_GUID_8D70D635_356B_4965_8207_220C5E8014DF
+#define INCLUDED_SharedRing_h_GUID_8D70D635_356B_4965_8207_220C5E8014DF
+
+// Internal Includes
+#include "Clock.h"
+#include "HDK.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <atomic>
+#include <cerrno>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HDKLOGGER_HAVE_SHARED_RING
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace hdklogger {
+/// Default number of reports a shared ring holds: a few seconds at the HDK's
+/// report rate, which is how far a reader can fall behind before losing any.
+static const std::size_t DEFAULT_SHARED_RING_CAPACITY = 4096;
+
+/// @brief Layout of the shared-memory segment: a Header followed by a
+/// power-of-two number of Slots, report `n` going in slot `n % capacity`.
+///
+/// Each slot is a seqlock: while the publisher writes report `n` into it, its
+/// sequence is `2n + 1`, and once it has, `2n + 2`. A reader copies a slot out
+/// and then checks the sequence hasn't changed, so it never sees a torn
+/// report, and knows from the sequence whether the report is the one it
+/// wanted or a later one that lapped it. Every field readers look at while
+/// the publisher is running is a lock-free atomic, so the publisher never
+/// waits for readers and readers need only read access.
+namespace shared_ring {
+    /// "HDKRING1", read as a little-endian number.
+    static const std::uint64_t MAGIC = 0x31474e49524b4448ULL;
+    /// Bumped whenever the layout changes.
+    static const std::uint32_t VERSION = 1;
+    /// Words of report data per slot.
+    static const std::size_t REPORT_WORDS = (HDK_MAX_REPORT_LENGTH + 7) / 8;
+    /// Room for the device's serial number, including its terminator.
+    static const std::size_t SERIAL_LENGTH = 64;
+
+    /// One report, on a cache line of its own.
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> sequence;
+        /// From monotonic_now() in the publisher.
+        std::atomic<std::int64_t> timestamp;
+        std::atomic<std::uint64_t> length;
+        std::atomic<std::uint64_t> data[REPORT_WORDS];
+    };
+
+    struct alignas(64) Header {
+        /// MAGIC, stored last, once everything else has been set up.
+        std::atomic<std::uint64_t> magic;
+        std::uint32_t version;
+        std::uint32_t slotSize;
+        std::uint64_t capacity;
+        /// Relates the timestamps to wall-clock time: see ClockAnchor.
+        std::int64_t anchorMonotonic;
+        std::int64_t anchorWallClock;
+        /// The ClockDomain of the timestamps.
+        std::uint32_t clockDomain;
+        /// Process ID of the publisher.
+        std::int32_t publisher;
+        char serialNumber[SERIAL_LENGTH];
+        /// Number of reports published so far, on a cache line of its own
+        /// since it changes with every one.
+        alignas(64) std::atomic<std::uint64_t> published;
+        /// Set once the publisher has exited: nothing more will arrive.
+        std::atomic<std::uint32_t> closed;
+    };
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                  "Shared rings need lock-free atomics to work across "
+                  "processes");
+    static_assert(std::is_standard_layout<Header>::value &&
+                      std::is_standard_layout<Slot>::value,
+                  "Shared ring layout must be the same in every process");
+
+    /// Size of the segment holding a ring of @p capacity reports.
+    inline std::size_t segment_size(std::uint64_t capacity) {
+        return sizeof(Header) + std::size_t(capacity) * sizeof(Slot);
+    }
+
+    /// Shared memory object names are a single path component with a
+    /// leading slash: this adds one if missing.
+    inline std::string object_name(std::string const &name) {
+        return (name.empty() || name[0] != '/') ? "/" + name : name;
+    }
+} // namespace shared_ring
+
+#ifdef HDKLOGGER_HAVE_SHARED_RING
+namespace detail {
+    /// Is the publisher that set up a ring still running? False if it has
+    /// closed the ring or its process is gone.
+    inline bool publisher_running(shared_ring::Header const &header) {
+        auto pid = header.publisher;
+        return !header.closed.load(std::memory_order_acquire) && pid > 0 &&
+               (0 == ::kill(pid, 0) || errno == EPERM);
+    }
+} // namespace detail
+
+/// @brief Publishes reports into a shared-memory ring for any number of
+/// other processes to read with SharedRingReader.
+///
+/// Publishing a report is a handful of stores into the ring, with no system
+/// calls, no locks and nothing that depends on how many readers there are or
+/// how far behind they are: the oldest report is simply overwritten. So it
+/// can be done straight from a capture thread.
+class SharedRingPublisher {
+  public:
+    /// Constructor: creates the shared memory object @p name (see
+    /// shm_open()), replacing any left behind by an earlier publisher that
+    /// is no longer running, to hold the last @p capacity (rounded up to a
+    /// power of two) reports from the device with the given serial number,
+    /// whose timestamps @p anchor relates to wall-clock time. Throws
+    /// std::runtime_error if another process is publishing under the same
+    /// name or the ring can't be created.
+    SharedRingPublisher(std::string const &name,
+                        std::string const &serialNumber,
+                        ClockAnchor const &anchor,
+                        std::size_t capacity = DEFAULT_SHARED_RING_CAPACITY)
+        : name_(shared_ring::object_name(name)) {
+        capacity_ = 1;
+        while (capacity_ < capacity) {
+            capacity_ *= 2;
+        }
+        size_ = shared_ring::segment_size(capacity_);
+        check_unused_();
+        ::shm_unlink(name_.c_str());
+        int fd = ::shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            fail_("create");
+        }
+        /// A fresh object reads as zeros, so every slot starts out with a
+        /// sequence that matches no report.
+        bool ok = 0 == ::ftruncate(fd, off_t(size_));
+        void *mapping = MAP_FAILED;
+        if (ok) {
+            mapping = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+        }
+        auto err = errno;
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            ::shm_unlink(name_.c_str());
+            errno = err;
+            fail_("map");
+        }
+        header_ = static_cast<shared_ring::Header *>(mapping);
+        slots_ = reinterpret_cast<shared_ring::Slot *>(header_ + 1);
+        header_->version = shared_ring::VERSION;
+        header_->slotSize = sizeof(shared_ring::Slot);
+        header_->capacity = capacity_;
+        header_->anchorMonotonic = anchor.monotonic;
+        header_->anchorWallClock = anchor.wallClock;
+        header_->clockDomain = std::uint32_t(MONOTONIC_CLOCK_DOMAIN);
+        header_->publisher = std::int32_t(::getpid());
+        std::strncpy(header_->serialNumber, serialNumber.c_str(),
+                     shared_ring::SERIAL_LENGTH - 1);
+        header_->magic.store(shared_ring::MAGIC, std::memory_order_release);
+    }
+
+    /// Destructor: marks the ring closed, for readers still mapping it, and
+    /// removes its name.
+    ~SharedRingPublisher() {
+        header_->closed.store(1, std::memory_order_release);
+        ::munmap(header_, size_);
+        ::shm_unlink(name_.c_str());
+    }
+
+    SharedRingPublisher(SharedRingPublisher const &) = delete;
+    SharedRingPublisher &operator=(SharedRingPublisher const &) = delete;
+
+    /// Name of the shared memory object, as given to shm_open().
+    std::string const &name() const { return name_; }
+    std::size_t capacity() const { return capacity_; }
+    /// Number of reports published so far.
+    std::uint64_t published() const { return next_; }
+
+    /// Publishes a report, overwriting the oldest one if the ring is full.
+    /// Reports longer than HDK_MAX_REPORT_LENGTH are truncated. Call from
+    /// one thread only.
+    void publish(std::int64_t timestamp, unsigned char const *data,
+                 std::size_t length) {
+        length = length < HDK_MAX_REPORT_LENGTH ? length
+                                                : HDK_MAX_REPORT_LENGTH;
+        std::uint64_t words[shared_ring::REPORT_WORDS] = {};
+        std::memcpy(words, data, length);
+
+        auto n = next_;
+        auto &slot = slots_[n & (capacity_ - 1)];
+        slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+        /// Keeps the stores below from becoming visible before the sequence
+        /// says the slot is being written.
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.timestamp.store(timestamp, std::memory_order_relaxed);
+        slot.length.store(length, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < shared_ring::REPORT_WORDS; ++i) {
+            slot.data[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.sequence.store(2 * n + 2, std::memory_order_release);
+        next_ = n + 1;
+        header_->published.store(next_, std::memory_order_release);
+    }
+
+  private:
+    /// Throws if a running process is still publishing under our name.
+    void check_unused_() {
+        int fd = ::shm_open(name_.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        void *mapping = MAP_FAILED;
+        if (0 == ::fstat(fd, &st) &&
+            st.st_size >= off_t(sizeof(shared_ring::Header))) {
+            mapping = ::mmap(nullptr, sizeof(shared_ring::Header), PROT_READ,
+                             MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            return;
+        }
+        auto header = static_cast<shared_ring::Header const *>(mapping);
+        auto pid = header->publisher;
+        bool running = header->magic.load(std::memory_order_acquire) ==
+                           shared_ring::MAGIC &&
+                       pid != ::getpid() &&
+                       detail::publisher_running(*header);
+        ::munmap(mapping, sizeof(shared_ring::Header));
+        if (running) {
+            throw std::runtime_error("Shared memory " + name_ +
+                                     " is already being published by "
+                                     "process " +
+                                     std::to_string(pid));
+        }
+    }
+
+    void fail_(const char *what) {
+        throw std::runtime_error(std::string("Could not ") + what +
+                                 " shared memory " + name_ + ": " +
+                                 std::strerror(errno));
+    }
+
+    std::string name_;
+    std::size_t capacity_ = 0;
+    std::size_t size_ = 0;
+    shared_ring::Header *header_ = nullptr;
+    shared_ring::Slot *slots_ = nullptr;
+    std::uint64_t next_ = 0;
+};
+
+/// @brief Reads the reports a SharedRingPublisher, typically in hdk-logger,
+/// publishes.
+///
+/// The ring is mapped read-only and read in place: checking for and taking a
+/// report involves no system calls, nothing the publisher or other readers
+/// can see, and no copying but into the caller's report. Readers poll, so one
+/// wanting to wait for reports sleeps or spins as suits it. A reader that
+/// falls more than the ring's capacity behind skips the reports overwritten
+/// in the meantime, counting them in lost().
+class SharedRingReader {
+  public:
+    /// Constructor: maps the shared memory object @p name (see shm_open()),
+    /// starting after the last report published so far. Throws
+    /// std::runtime_error if it doesn't exist or isn't (yet) a shared ring.
+    explicit SharedRingReader(std::string const &name)
+        : name_(shared_ring::object_name(name)) {
+        int fd = ::shm_open(name_.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open shared memory " + name_ +
+                                     ": " + std::strerror(errno));
+        }
+        struct stat st;
+        void *mapping = MAP_FAILED;
+        if (0 == ::fstat(fd, &st) &&
+            st.st_size >= off_t(sizeof(shared_ring::Header))) {
+            size_ = std::size_t(st.st_size);
+            mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Could not map shared memory " + name_);
+        }
+        header_ = static_cast<shared_ring::Header const *>(mapping);
+        slots_ = reinterpret_cast<shared_ring::Slot const *>(header_ + 1);
+        /// The publisher stores the magic last, with release: only once it
+        /// is seen are the other header fields safe to read.
+        bool ready = header_->magic.load(std::memory_order_acquire) ==
+                     shared_ring::MAGIC;
+        capacity_ = ready ? header_->capacity : 0;
+        if (!ready || header_->version != shared_ring::VERSION ||
+            header_->slotSize != sizeof(shared_ring::Slot) ||
+            capacity_ == 0 || (capacity_ & (capacity_ - 1)) != 0 ||
+            size_ < shared_ring::segment_size(capacity_)) {
+            ::munmap(mapping, size_);
+            throw std::runtime_error("Shared memory " + name_ +
+                                     " is not an HDK report ring");
+        }
+        next_ = published();
+    }
+
+    ~SharedRingReader() {
+        ::munmap(const_cast<shared_ring::Header *>(header_), size_);
+    }
+
+    SharedRingReader(SharedRingReader const &) = delete;
+    SharedRingReader &operator=(SharedRingReader const &) = delete;
+
+    std::string const &name() const { return name_; }
+    std::uint64_t capacity() const { return capacity_; }
+    /// Serial number of the device whose reports these are.
+    std::string serial_number() const {
+        return std::string(header_->serialNumber,
+                           strnlen(header_->serialNumber,
+                                   shared_ring::SERIAL_LENGTH));
+    }
+    /// Relates the report timestamps to wall-clock time.
+    ClockAnchor anchor() const {
+        ClockAnchor ret;
+        ret.monotonic = header_->anchorMonotonic;
+        ret.wallClock = header_->anchorWallClock;
+        return ret;
+    }
+    /// Clock the report timestamps come from: when it's the one this
+    /// process's monotonic_now() reads, they can be compared directly.
+    ClockDomain clock_domain() const {
+        return ClockDomain(header_->clockDomain);
+    }
+
+    /// Number of reports published so far.
+    std::uint64_t published() const {
+        return header_->published.load(std::memory_order_acquire);
+    }
+    /// Has the publisher exited? No more reports will arrive.
+    bool closed() const {
+        return 0 != header_->closed.load(std::memory_order_acquire);
+    }
+    /// Is the publisher still running? Unlike closed(), this also notices
+    /// one that was killed or crashed, but takes a system call: check it
+    /// only while idle.
+    bool publisher_running() const {
+        return detail::publisher_running(*header_);
+    }
+    /// Number of the next report to be read.
+    std::uint64_t position() const { return next_; }
+    /// Moves to the oldest report the ring still holds.
+    void rewind() {
+        auto head = published();
+        next_ = head > capacity_ ? head - capacity_ : 0;
+    }
+    /// Number of reports overwritten before this reader got to them.
+    std::uint64_t lost() const { return lost_; }
+
+    /// Takes the next report, if one has been published, returning false if
+    /// none has. @p report is left as is unless a report is returned.
+    bool next(std::int64_t &timestamp, HDKReport &report) {
+        for (;;) {
+            auto head = published();
+            if (next_ >= head) {
+                return false;
+            }
+            if (head - next_ > capacity_) {
+                lost_ += head - capacity_ - next_;
+                next_ = head - capacity_;
+            }
+            auto n = next_++;
+            if (read_(n, timestamp, report)) {
+                return true;
+            }
+            /// Overwritten as we read it.
+            ++lost_;
+        }
+    }
+
+  private:
+    /// Copies report @p n out of its slot, returning false if the slot no
+    /// longer (or doesn't yet) hold it.
+    bool read_(std::uint64_t n, std::int64_t &timestamp,
+               HDKReport &report) const {
+        auto const &slot = slots_[n & (capacity_ - 1)];
+        auto expected = 2 * n + 2;
+        if (slot.sequence.load(std::memory_order_acquire) != expected) {
+            return false;
+        }
+        auto ts = slot.timestamp.load(std::memory_order_relaxed);
+        auto length = std::size_t(slot.length.load(std::memory_order_relaxed));
+        std::uint64_t words[shared_ring::REPORT_WORDS];
+        for (std::size_t i = 0; i < shared_ring::REPORT_WORDS; ++i) {
+            words[i] = slot.data[i].load(std::memory_order_relaxed);
+        }
+        /// Keeps the loads above from being satisfied after the check below.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != expected ||
+            length > HDK_MAX_REPORT_LENGTH) {
+            return false;
+        }
+        timestamp = ts;
+        std::memcpy(report.data(), words, length);
+        report.resize(length);
+        return true;
+    }
+
+    std::string name_;
+    std::size_t size_ = 0;
+    shared_ring::Header const *header_ = nullptr;
+    shared_ring::Slot const *slots_ = nullptr;
+    std::uint64_t capacity_ = 0;
+    std::uint64_t next_ = 0;
+    std::uint64_t lost_ = 0;
+};
+#endif // HDKLOGGER_HAVE_SHARED_RING
+} // namespace hdklogger
+
+#endif // INCLUDED_SharedRing_h_GUID_8D70D635_356B_4965_8207_220C5E8014DF
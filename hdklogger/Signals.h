@@ -0,0 +1,118 @@
+/** @file
+    @brief Header handling the signals that ask the logger to shut down cleanly.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Signals_h_GUID_74956E00_1442_4609_8058_21F30AC25356
+#define INCLUDED_Signals_h_GUID_74956E00_1442_4609_8058_21F30AC25356
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <atomic>
+#include <csignal>
+
+namespace hdklogger {
+namespace detail {
+    /// Flag set from the signal handler: must be lock-free to be safe there.
+    inline std::atomic<bool> &stop_signal_flag() {
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+
+    extern "C" inline void handle_stop_signal(int) {
+        stop_signal_flag().store(true, std::memory_order_relaxed);
+    }
+
+    /// Flag set from the signal handler when statistics are requested.
+    inline std::atomic<bool> &stats_signal_flag() {
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+
+    extern "C" inline void handle_stats_signal(int) {
+        stats_signal_flag().store(true, std::memory_order_relaxed);
+    }
+
+    /// Flag set from the signal handler when a trace snapshot is requested.
+    inline std::atomic<bool> &trace_signal_flag() {
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+
+    extern "C" inline void handle_trace_signal(int) {
+        trace_signal_flag().store(true, std::memory_order_relaxed);
+    }
+} // namespace detail
+
+static_assert(ATOMIC_BOOL_LOCK_FREE == 2,
+              "Need a lock-free atomic bool to handle signals safely.");
+
+/// Installs handlers so SIGINT and SIGTERM request a clean shutdown rather
+/// than killing the process.
+inline void install_stop_signal_handlers() {
+    detail::stop_signal_flag();
+    std::signal(SIGINT, &detail::handle_stop_signal);
+    std::signal(SIGTERM, &detail::handle_stop_signal);
+}
+
+/// Has SIGINT or SIGTERM been received?
+inline bool stop_signal_received() {
+    return detail::stop_signal_flag().load(std::memory_order_relaxed);
+}
+
+/// Installs a handler so SIGUSR1 (where it exists) requests a statistics
+/// printout.
+inline void install_stats_signal_handler() {
+    detail::stats_signal_flag();
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, &detail::handle_stats_signal);
+#endif
+}
+
+/// Has a statistics printout been requested since the last call?
+inline bool stats_signal_received() {
+    return detail::stats_signal_flag().exchange(false,
+                                                std::memory_order_relaxed);
+}
+
+/// Installs a handler so SIGUSR2 (where it exists) requests a trace
+/// snapshot.
+inline void install_trace_signal_handler() {
+    detail::trace_signal_flag();
+#ifdef SIGUSR2
+    std::signal(SIGUSR2, &detail::handle_trace_signal);
+#endif
+}
+
+/// Has a trace snapshot been requested since the last call?
+inline bool trace_signal_received() {
+    return detail::trace_signal_flag().exchange(false,
+                                                std::memory_order_relaxed);
+}
+} // namespace hdklogger
+
+#endif // INCLUDED_Signals_h_GUID_74956E00_1442_4609_8058_21F30AC25356
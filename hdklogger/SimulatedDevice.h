@@ -0,0 +1,263 @@
+/** @file
+    @brief Header defining a simulated HDK tracker, to capture without
+   hardware.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_SimulatedDevice_h_GUID_EF79851D_A37C_4F4C_BEC0_174E14E40AF1
+#define INCLUDED_SimulatedDevice_h_GUID_EF79851D_A37C_4F4C_BEC0_174E14E40AF1
+
+// Internal Includes
+#include "Clock.h"
+#include "HDK.h"
+
+// Library/third-party includes
+#include "hidapipp/Device.h"
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+namespace hdklogger {
+/// What a SimulatedDevice produces, and when.
+struct SimulationSettings {
+    /// Reports per second.
+    double rate = 1000;
+    /// Each report's arrival is moved by up to this many microseconds either
+    /// way (uniformly distributed, but never before the previous report).
+    double jitter = 0;
+    /// Chance of each report being lost: its sequence number is skipped.
+    double dropProbability = 0;
+    /// Burst pattern: out of every burstEvery reports, the first burstLength
+    /// are held back and arrive all at once. 0 disables bursts.
+    std::size_t burstEvery = 0;
+    std::size_t burstLength = 0;
+    /// Seed for the random numbers behind jitter and drops: the same seed
+    /// gives the same reports and timing.
+    std::uint64_t seed = 1;
+    /// Deliver reports at their scheduled times (true), or as fast as they
+    /// can be read (false).
+    bool realtime = true;
+    /// Report version to produce.
+    std::uint8_t version = 3;
+    /// Rotation rate of the simulated tracker about its Z axis, in rad/s.
+    double angularSpeed = 1;
+};
+
+/// Small, fast pseudo-random number generator (SplitMix64), used instead of
+/// the standard library's so simulations come out the same on every platform.
+class SplitMix64 {
+  public:
+    explicit SplitMix64(std::uint64_t seed = 0) : state_(seed) {}
+
+    std::uint64_t next() {
+        std::uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    /// Uniformly distributed in [0, 1).
+    double uniform() { return double(next() >> 11) * (1. / 9007199254740992.); }
+
+  private:
+    std::uint64_t state_;
+};
+
+/// A device producing HDK tracker reports (a tracker spinning about its Z
+/// axis) at a configurable rate, with controllable jitter, drops and bursts,
+/// so the capture pipeline can be exercised and benchmarked without hardware.
+///
+/// Most functionality provided by hidapi::DeviceBase.
+class SimulatedDevice : public hidapi::DeviceBase<SimulatedDevice> {
+  public:
+    using base = hidapi::DeviceBase<SimulatedDevice>;
+    /// Default, empty constructor. Not very useful on its own, mostly for move
+    /// assignment.
+    SimulatedDevice() : base() {}
+
+    /// Constructor: the simulated device starts producing reports when first
+    /// read from.
+    explicit SimulatedDevice(SimulationSettings const &settings)
+        : base(), settings_(settings), rng_(settings.seed), open_(true),
+          period_(settings.rate > 0 ? 1e9 / settings.rate : 0) {}
+
+    SimulatedDevice(SimulatedDevice &&) = default;
+    SimulatedDevice &operator=(SimulatedDevice &&) = default;
+    /// Not copy constructible
+    SimulatedDevice(SimulatedDevice const &) = delete;
+    /// Not copy assignable
+    SimulatedDevice &operator=(SimulatedDevice const &) = delete;
+
+    /// Not backed by a HIDAPI device.
+    hid_device *get() const { return nullptr; }
+
+    /// Sets whether read() waits for a report (the default) or returns
+    /// immediately, like `hid_set_nonblocking()`.
+    void set_nonblocking(bool nonblocking) { nonblocking_ = nonblocking; }
+
+    SimulationSettings const &settings() const { return settings_; }
+
+    /// Reports produced so far, including those dropped.
+    std::uint64_t generated() const { return next_; }
+
+    /// Reports dropped so far.
+    std::uint64_t dropped() const { return dropped_; }
+
+  private:
+    friend class hidapi::DeviceBase<SimulatedDevice>;
+
+    bool valid_impl() const { return open_; }
+
+    int read_impl(hidapi::DataByte *buf, std::size_t maxLength) {
+        return read_timeout_impl(buf, maxLength, nonblocking_ ? 0 : -1);
+    }
+
+    int read_timeout_impl(hidapi::DataByte *buf, std::size_t maxLength,
+                          int milliseconds) {
+        if (!havePending_) {
+            schedule_next_();
+        }
+        if (settings_.realtime) {
+            if (!started_) {
+                started_ = true;
+                start_ = monotonic_now();
+            }
+            auto wait = pendingDue_ - (monotonic_now() - start_);
+            if (wait > 0) {
+                if (milliseconds == 0) {
+                    return 0;
+                }
+                if (milliseconds > 0 &&
+                    wait > std::int64_t(milliseconds) * 1000000) {
+                    std::this_thread::sleep_for(
+                        std::chrono::milliseconds(milliseconds));
+                    return 0;
+                }
+                std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+            }
+        }
+        havePending_ = false;
+        return fill_report_(buf, maxLength, pendingIndex_);
+    }
+
+    int get_feature_report_impl(hidapi::DataByte *, std::size_t) {
+        return -1;
+    }
+
+    const wchar_t *error_impl() {
+        return L"Not supported by the simulated device";
+    }
+
+    /// Picks the next report to deliver (skipping dropped ones) and works out
+    /// when it is due, in nanoseconds from the start.
+    void schedule_next_() {
+        for (;;) {
+            pendingIndex_ = next_++;
+            if (settings_.dropProbability > 0 &&
+                rng_.uniform() < settings_.dropProbability) {
+                ++dropped_;
+                continue;
+            }
+            break;
+        }
+        auto slot = pendingIndex_;
+        if (settings_.burstEvery > 0 && settings_.burstLength > 0) {
+            auto pos = slot % settings_.burstEvery;
+            if (pos < settings_.burstLength) {
+                /// Held back until the last report of the burst is due.
+                slot += settings_.burstLength - 1 - pos;
+            }
+        }
+        auto due = std::int64_t(double(slot) * period_);
+        if (settings_.jitter > 0) {
+            due += std::int64_t((rng_.uniform() * 2 - 1) * settings_.jitter *
+                                1000.);
+        }
+        pendingDue_ = std::max(due, lastDue_);
+        lastDue_ = pendingDue_;
+        havePending_ = true;
+    }
+
+    static void store_fixed(hidapi::DataByte *dest, double val, int bits) {
+        auto fixed = std::lround(val * double(1 << bits));
+        fixed = std::max(-32768L, std::min(32767L, fixed));
+        auto raw = std::uint16_t(std::int16_t(fixed));
+        dest[0] = hidapi::DataByte(raw);
+        dest[1] = hidapi::DataByte(raw >> 8);
+    }
+
+    /// Writes the report with the given index into the buffer.
+    int fill_report_(hidapi::DataByte *buf, std::size_t maxLength,
+                     std::uint64_t index) {
+        auto len = std::min(maxLength, HDK_MAX_REPORT_LENGTH);
+        hidapi::DataByte report[HDK_MAX_REPORT_LENGTH] = {0};
+        report[0] = settings_.version;
+        report[HDK_SEQUENCE_OFFSET] = hidapi::DataByte(index);
+        /// Orientation: rotating about Z.
+        auto halfAngle =
+            settings_.angularSpeed * double(index) * period_ * 1e-9 / 2;
+        auto q = report + HDK_QUATERNION_OFFSET;
+        store_fixed(q + 4, std::sin(halfAngle),
+                    HDK_QUATERNION_FRACTIONAL_BITS);
+        store_fixed(q + 6, std::cos(halfAngle),
+                    HDK_QUATERNION_FRACTIONAL_BITS);
+        if (settings_.version >= HDK_VELOCITY_MIN_VERSION) {
+            store_fixed(report + HDK_VELOCITY_OFFSET + 4,
+                        std::sin(settings_.angularSpeed * HDK_VELOCITY_DT / 2),
+                        HDK_VELOCITY_FRACTIONAL_BITS);
+        }
+        std::memcpy(buf, report, len);
+        return static_cast<int>(len);
+    }
+
+    SimulationSettings settings_;
+    SplitMix64 rng_;
+    bool open_ = false;
+    bool nonblocking_ = false;
+    /// Nanoseconds between reports.
+    double period_ = 0;
+    bool started_ = false;
+    std::int64_t start_ = 0;
+    /// Index of the next report to generate.
+    std::uint64_t next_ = 0;
+    std::uint64_t dropped_ = 0;
+    bool havePending_ = false;
+    std::uint64_t pendingIndex_ = 0;
+    std::int64_t pendingDue_ = 0;
+    std::int64_t lastDue_ = 0;
+};
+
+/// Capture pipeline customization point: simulated trackers report at their
+/// configured rate.
+inline std::int64_t report_period(SimulatedDevice const &dev) {
+    auto rate = dev.settings().rate;
+    return rate > 0 ? std::int64_t(1e9 / rate) : HDK_REPORT_PERIOD_NS;
+}
+} // namespace hdklogger
+
+#endif // INCLUDED_SimulatedDevice_h_GUID_EF79851D_A37C_4F4C_BEC0_174E14E40AF1
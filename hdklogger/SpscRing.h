@@ -0,0 +1,209 @@
+/** @file
+    @brief Header defining a lock-free single-producer, single-consumer
+   ring buffer.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_SpscRing_h_GUID_0964C899_5535_416B_9E84_5213DAB2CCB5
+#define INCLUDED_SpscRing_h_GUID_0964C899_5535_416B_9E84_5213DAB2CCB5
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <algorithm>
+#include <atomic>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <memory>
+
+namespace hdklogger {
+/// Size used to keep data written by different threads on separate cache
+/// lines.
+static const std::size_t CACHE_LINE_SIZE = 64;
+
+/// A bounded, lock-free ring buffer for exactly one producer thread and one
+/// consumer thread.
+///
+/// All storage is allocated once, in the constructor. The producer may fill a
+/// slot in place (producer_slot() then commit()) to avoid a copy; if the ring
+/// is full, pushes fail and are counted as overflows.
+template <typename T> class SpscRing {
+  public:
+    /// Constructor: capacity is rounded up to a power of two.
+    explicit SpscRing(std::size_t capacity)
+        : mask_(round_up_pow2(capacity) - 1), slots_(new T[mask_ + 1]) {}
+
+    SpscRing(SpscRing const &) = delete;
+    SpscRing &operator=(SpscRing const &) = delete;
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    /// Touches every page of the ring's storage, so that the first pass
+    /// through it doesn't take page faults. Call before the ring is in use.
+    void prefault() {
+        static const std::size_t PAGE_SIZE = 4096;
+        auto bytes = reinterpret_cast<volatile char *>(slots_.get());
+        auto size = sizeof(T) * capacity();
+        for (std::size_t i = 0; i < size; i += PAGE_SIZE) {
+            bytes[i] = 0;
+        }
+    }
+
+    /// @name Producer side
+    /// @{
+
+    /// Gets the next free slot to fill in place, or nullptr if the ring is
+    /// full. Call commit() to publish it.
+    T *producer_slot() {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ > mask_) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ > mask_) {
+                return nullptr;
+            }
+        }
+        return &slots_[tail & mask_];
+    }
+
+    /// Number of slots the producer can fill before the ring is full.
+    std::size_t producer_room() {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ > mask_) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+        }
+        return capacity() - (tail - cachedHead_);
+    }
+
+    /// Publishes the slot most recently returned by producer_slot().
+    void commit() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    }
+
+    /// Copies an item into the ring, returning false (and counting an
+    /// overflow) if it is full.
+    bool try_push(T const &item) {
+        auto slot = producer_slot();
+        if (!slot) {
+            record_overflow();
+            return false;
+        }
+        *slot = item;
+        commit();
+        return true;
+    }
+
+    /// Counts an item the producer had to discard because the ring was full.
+    void record_overflow() {
+        overflows_.store(overflows_.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    }
+    /// @}
+
+    /// @name Consumer side
+    /// @{
+
+    /// Gets the oldest published item, or nullptr if the ring is empty. Call
+    /// pop() once done with it.
+    T const *front() {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) {
+                return nullptr;
+            }
+        }
+        return &slots_[head & mask_];
+    }
+
+    /// Releases the item most recently returned by front().
+    void pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    }
+
+    /// Copies out and releases the oldest item, if any.
+    bool try_pop(T &item) {
+        auto slot = front();
+        if (!slot) {
+            return false;
+        }
+        item = *slot;
+        pop();
+        return true;
+    }
+    /// @}
+
+    /// @name Thread-safe observers
+    /// @{
+
+    /// Approximate number of items waiting to be consumed.
+    std::size_t size() const {
+        /// Head first: both only grow and tail never falls behind head, so
+        /// a tail read after it is never less than it.
+        auto head = head_.load(std::memory_order_acquire);
+        auto tail = tail_.load(std::memory_order_acquire);
+        return std::min(std::size_t(tail - head), capacity());
+    }
+
+    /// Number of items dropped because the consumer fell behind.
+    std::uint64_t overflows() const {
+        return overflows_.load(std::memory_order_relaxed);
+    }
+    /// @}
+
+  private:
+    static std::size_t round_up_pow2(std::size_t n) {
+        std::size_t ret = 1;
+        while (ret < n) {
+            ret <<= 1;
+        }
+        return ret;
+    }
+
+    std::size_t const mask_;
+    std::unique_ptr<T[]> slots_;
+
+    /// Padding (rather than alignas, which would make the ring over-aligned
+    /// and so unsafe to allocate with pre-C++17 new) keeps each thread's
+    /// data on its own cache lines.
+    char padding0_[CACHE_LINE_SIZE];
+    /// Written by the consumer.
+    std::atomic<std::size_t> head_{0};
+    /// Consumer's cached copy of tail_.
+    std::size_t cachedTail_ = 0;
+
+    char padding1_[CACHE_LINE_SIZE];
+    /// Written by the producer.
+    std::atomic<std::size_t> tail_{0};
+    /// Producer's cached copy of head_.
+    std::size_t cachedHead_ = 0;
+    std::atomic<std::uint64_t> overflows_{0};
+    char padding2_[CACHE_LINE_SIZE];
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_SpscRing_h_GUID_0964C899_5535_416B_9E84_5213DAB2CCB5
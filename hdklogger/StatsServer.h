@@ -0,0 +1,433 @@
+/** @file
+    @brief Header defining a server for live capture statistics on a local Unix
+    domain socket, and the client side of its protocol.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_StatsServer_h_GUID_F28934F5_ED2F_422F_96F6_EF561D0C75FE
+#define INCLUDED_StatsServer_h_GUID_F28934F5_ED2F_422F_96F6_EF561D0C75FE
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <cerrno>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HDKLOGGER_HAVE_STATS_SERVER
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace hdklogger {
+/// Version of the statistics protocol: bumped if fields change meaning.
+static const int STATS_PROTOCOL_VERSION = 1;
+
+/// A snapshot of one device's capture statistics.
+struct DeviceStats {
+    std::string label;
+    std::uint64_t reports = 0;
+    /// Reports dropped because the output fell behind and the ring filled.
+    std::uint64_t ringDropped = 0;
+    std::size_t queueDepth = 0;
+    std::size_t queueCapacity = 0;
+    /// @name Judging by sequence numbers
+    /// @{
+    std::uint64_t seqDropped = 0;
+    std::uint64_t seqGaps = 0;
+    std::uint64_t duplicated = 0;
+    std::uint64_t reordered = 0;
+    /// @}
+    /// @name Inter-arrival time, in nanoseconds
+    /// @{
+    std::uint64_t interArrivalP50 = 0;
+    std::uint64_t interArrivalP90 = 0;
+    std::uint64_t interArrivalP99 = 0;
+    std::uint64_t interArrivalP999 = 0;
+    std::uint64_t interArrivalMax = 0;
+    std::uint64_t interArrivalCount = 0;
+    /// @}
+};
+
+/// Takes a snapshot of a CaptureChannel's statistics. Only reads counters
+/// the capture thread keeps with relaxed atomics, so it is safe from any
+/// thread and never slows the capture.
+template <typename Channel>
+inline DeviceStats collect_device_stats(Channel const &channel) {
+    DeviceStats ret;
+    auto const &reader = channel.reader();
+    auto const &seq = reader.sequence();
+    auto const &hist = reader.inter_arrival();
+    ret.label = channel.label();
+    ret.reports = reader.reports();
+    ret.ringDropped = channel.ring().overflows();
+    ret.queueDepth = channel.ring().size();
+    ret.queueCapacity = channel.ring().capacity();
+    ret.seqDropped = seq.dropped();
+    ret.seqGaps = seq.gaps();
+    ret.duplicated = seq.duplicated();
+    ret.reordered = seq.reordered();
+    ret.interArrivalP50 = hist.percentile(50);
+    ret.interArrivalP90 = hist.percentile(90);
+    ret.interArrivalP99 = hist.percentile(99);
+    ret.interArrivalP999 = hist.percentile(99.9);
+    ret.interArrivalMax = hist.max();
+    ret.interArrivalCount = hist.count();
+    return ret;
+}
+
+/// @name Protocol
+/// @brief A snapshot is plain text: a header line, then a line per device.
+/// Each line is a record type followed by space-separated `key=value`
+/// fields, so it is easy to parse from scripts too.
+/// @{
+namespace detail {
+    /// Makes a value safe to put in a `key=value` field.
+    inline std::string stats_field_value(std::string const &value) {
+        auto ret = value.empty() ? std::string("-") : value;
+        for (auto &c : ret) {
+            if (c == ' ' || c == '=' || c == '\t' || c == '\n' || c == '\r') {
+                c = '_';
+            }
+        }
+        return ret;
+    }
+} // namespace detail
+
+/// Formats a snapshot: @p timestamp (from monotonic_now()) and @p uptime (in
+/// nanoseconds) say when it was taken.
+inline std::string format_stats(std::int64_t timestamp, std::int64_t uptime,
+                                std::vector<DeviceStats> const &devices) {
+    std::ostringstream os;
+    os << "hdk-logger version=" << STATS_PROTOCOL_VERSION
+       << " time_ns=" << timestamp << " uptime_ns=" << uptime
+       << " devices=" << devices.size() << "\n";
+    for (auto const &dev : devices) {
+        os << "device label=" << detail::stats_field_value(dev.label)
+           << " reports=" << dev.reports
+           << " ring_dropped=" << dev.ringDropped
+           << " queue_depth=" << dev.queueDepth
+           << " queue_capacity=" << dev.queueCapacity
+           << " seq_dropped=" << dev.seqDropped
+           << " seq_gaps=" << dev.seqGaps
+           << " duplicated=" << dev.duplicated
+           << " reordered=" << dev.reordered
+           << " interarrival_p50_ns=" << dev.interArrivalP50
+           << " interarrival_p90_ns=" << dev.interArrivalP90
+           << " interarrival_p99_ns=" << dev.interArrivalP99
+           << " interarrival_p99.9_ns=" << dev.interArrivalP999
+           << " interarrival_max_ns=" << dev.interArrivalMax
+           << " interarrival_count=" << dev.interArrivalCount << "\n";
+    }
+    return os.str();
+}
+
+/// One parsed line of a snapshot.
+struct StatsRecord {
+    std::string type;
+    std::map<std::string, std::string> fields;
+
+    /// A field's value as a number, or 0 if it is missing.
+    std::uint64_t number(std::string const &key) const {
+        auto it = fields.find(key);
+        return it == fields.end() ? 0
+                                  : std::strtoull(it->second.c_str(), nullptr,
+                                                  10);
+    }
+};
+
+/// Splits a snapshot into its lines.
+inline std::vector<StatsRecord> parse_stats(std::string const &snapshot) {
+    std::vector<StatsRecord> ret;
+    std::istringstream is(snapshot);
+    std::string line;
+    while (std::getline(is, line)) {
+        std::istringstream words(line);
+        StatsRecord record;
+        if (!(words >> record.type)) {
+            continue;
+        }
+        std::string word;
+        while (words >> word) {
+            auto eq = word.find('=');
+            if (eq != std::string::npos) {
+                record.fields[word.substr(0, eq)] = word.substr(eq + 1);
+            }
+        }
+        ret.push_back(record);
+    }
+    return ret;
+}
+/// @}
+
+#ifdef HDKLOGGER_HAVE_STATS_SERVER
+namespace detail {
+    /// Fills in a Unix domain socket address, throwing if the path is too
+    /// long for one.
+    inline sockaddr_un unix_address(std::string const &path) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Invalid socket path: " + path);
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+        return addr;
+    }
+
+    /// Tries connecting to the socket at @p addr without waiting, returning
+    /// 0 if a server is listening there (even if too busy to accept us), or
+    /// else the error: ECONNREFUSED for a stale socket.
+    inline int probe_socket(sockaddr_un const &addr) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return errno;
+        }
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        int err = 0;
+        if (0 != ::connect(fd, reinterpret_cast<sockaddr const *>(&addr),
+                           sizeof(addr))) {
+            err = errno;
+            if (err == EAGAIN || err == EINPROGRESS) {
+                err = 0;
+            }
+        }
+        ::close(fd);
+        return err;
+    }
+
+    /// Writes all of @p data to a socket, without raising SIGPIPE if the
+    /// other end has gone.
+    inline bool send_all(int fd, std::string const &data) {
+#ifdef MSG_NOSIGNAL
+        static const int FLAGS = MSG_NOSIGNAL;
+#else
+        static const int FLAGS = 0;
+#endif
+        std::size_t sent = 0;
+        while (sent < data.size()) {
+            auto n = ::send(fd, data.data() + sent, data.size() - sent, FLAGS);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            sent += std::size_t(n);
+        }
+        return true;
+    }
+} // namespace detail
+
+/// Serves statistics snapshots on a Unix domain socket: each client that
+/// connects is sent the current snapshot, then the connection is closed.
+///
+/// Runs its own thread, which only wakes for connections, so it stays off
+/// the capture and output threads' paths.
+class StatsServer {
+  public:
+    /// How long a client may take to accept a snapshot before it is dropped.
+    static const int SEND_TIMEOUT_MS = 1000;
+
+    /// Constructor: listens on @p path, calling @p snapshot (on the server's
+    /// thread) for each client. A stale socket left at @p path, which nothing
+    /// is listening on, is replaced; anything else there is left alone.
+    /// Throws std::runtime_error if another process is serving at @p path or
+    /// the socket can't be set up.
+    StatsServer(std::string const &path, std::function<std::string()> snapshot)
+        : path_(path), snapshot_(std::move(snapshot)) {
+        auto addr = detail::unix_address(path);
+        struct stat st;
+        if (0 == ::lstat(path.c_str(), &st) && S_ISSOCK(st.st_mode)) {
+            auto err = detail::probe_socket(addr);
+            if (err == 0) {
+                throw std::runtime_error("Statistics socket " + path +
+                                         " is already being served by "
+                                         "another process");
+            }
+            if (err == ECONNREFUSED) {
+                ::unlink(path.c_str());
+            }
+        }
+        listen_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_ < 0 || 0 != ::pipe(wake_)) {
+            fail_("create statistics socket");
+        }
+        ::fcntl(listen_, F_SETFD, FD_CLOEXEC);
+        if (0 != ::bind(listen_, reinterpret_cast<sockaddr *>(&addr),
+                        sizeof(addr))) {
+            fail_("bind statistics socket " + path);
+        }
+        bound_ = true;
+        if (0 != ::listen(listen_, 8)) {
+            fail_("listen on statistics socket " + path);
+        }
+        thread_ = std::thread([&] { run_(); });
+    }
+
+    ~StatsServer() {
+        if (thread_.joinable()) {
+            char c = 0;
+            while (::write(wake_[1], &c, 1) < 0 && errno == EINTR) {
+            }
+            thread_.join();
+        }
+        close_();
+    }
+
+    StatsServer(StatsServer const &) = delete;
+    StatsServer &operator=(StatsServer const &) = delete;
+
+    std::string const &path() const { return path_; }
+
+  private:
+    void run_() {
+        for (;;) {
+            pollfd fds[2];
+            fds[0].fd = listen_;
+            fds[0].events = POLLIN;
+            fds[1].fd = wake_[0];
+            fds[1].events = POLLIN;
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            if (fds[1].revents) {
+                return;
+            }
+            if (!(fds[0].revents & POLLIN)) {
+                continue;
+            }
+            auto client = ::accept(listen_, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+#ifdef SO_NOSIGPIPE
+            int one = 1;
+            ::setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            timeval timeout;
+            timeout.tv_sec = SEND_TIMEOUT_MS / 1000;
+            timeout.tv_usec = (SEND_TIMEOUT_MS % 1000) * 1000;
+            ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                         sizeof(timeout));
+            detail::send_all(client, snapshot_());
+            ::close(client);
+        }
+    }
+
+    [[noreturn]] void fail_(std::string const &what) {
+        auto message = "Could not " + what + ": " + std::strerror(errno);
+        close_();
+        throw std::runtime_error(message);
+    }
+
+    void close_() {
+        if (listen_ >= 0) {
+            ::close(listen_);
+            listen_ = -1;
+        }
+        for (auto &fd : wake_) {
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        if (bound_) {
+            ::unlink(path_.c_str());
+            bound_ = false;
+        }
+    }
+
+    std::string path_;
+    std::function<std::string()> snapshot_;
+    int listen_ = -1;
+    int wake_[2] = {-1, -1};
+    bool bound_ = false;
+    std::thread thread_;
+};
+
+/// Connects to a StatsServer at @p path and reads a snapshot into
+/// @p snapshot. Returns false, with the reason in @p error, if it can't.
+inline bool fetch_stats(std::string const &path, std::string &snapshot,
+                        std::string &error) {
+    sockaddr_un addr;
+    try {
+        addr = detail::unix_address(path);
+    } catch (std::exception &e) {
+        error = e.what();
+        return false;
+    }
+    auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 ||
+        0 != ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+        error = std::strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+    snapshot.clear();
+    char buf[4096];
+    for (;;) {
+        auto n = ::read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            error = std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        snapshot.append(buf, std::size_t(n));
+    }
+    ::close(fd);
+    return true;
+}
+#endif // HDKLOGGER_HAVE_STATS_SERVER
+} // namespace hdklogger
+
+#endif // INCLUDED_StatsServer_h_GUID_F28934F5_ED2F_422F_96F6_EF561D0C75FE
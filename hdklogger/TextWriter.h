@@ -0,0 +1,132 @@
+/** @file
+    @brief Header defining the human-readable text output.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_TextWriter_h_GUID_A9233736_D432_46A0_AC1B_F7440ED819E9
+#define INCLUDED_TextWriter_h_GUID_A9233736_D432_46A0_AC1B_F7440ED819E9
+
+// Internal Includes
+#include "Capture.h"
+#include "Clock.h"
+#include "Decoder.h"
+#include "Trace.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace hdklogger {
+/// Writes a human-readable line per captured report.
+class TextWriter {
+  public:
+    /// Constructor: writes to the named file, or to stdout if the path is
+    /// empty or "-", starting with a line relating the monotonic timestamps
+    /// to wall-clock time. Every line is prefixed with @p label, if given, to
+    /// tell devices apart when several share stdout. Throws
+    /// std::runtime_error if the file cannot be created.
+    TextWriter(std::string const &path, ClockAnchor const &anchor,
+               std::string const &label = std::string())
+        : os_(&std::cout),
+          prefix_(label.empty() ? label : label + ": ") {
+        if (!path.empty() && path != "-") {
+            file_.open(path);
+            if (!file_) {
+                throw std::runtime_error("Could not create output file " +
+                                         path);
+            }
+            os_ = &file_;
+        }
+        write_anchor_(anchor);
+    }
+
+    /// Constructor writing to an existing stream, which must outlive this
+    /// object.
+    TextWriter(std::ostream &os, ClockAnchor const &anchor,
+               std::string const &label = std::string())
+        : os_(&os), prefix_(label.empty() ? label : label + ": ") {
+        write_anchor_(anchor);
+    }
+
+    TextWriter(TextWriter const &) = delete;
+    TextWriter &operator=(TextWriter const &) = delete;
+
+    /// Sets whether each line also gives the decoded orientation and angular
+    /// velocity (off by default).
+    void set_decode(bool decode) { decode_ = decode; }
+
+    /// Writes a line for a captured report.
+    void write(CapturedReport const &captured) {
+        auto const &report = captured.report;
+        if (report.size() < 2) {
+            return;
+        }
+        TraceScope trace(TracePoint::Format, report[1]);
+        *os_ << prefix_ << "Timestamp: " << captured.timestamp
+             << " Report size: " << report.size()
+             << " Version number: " << int(report[0])
+             << " Sequence number: " << int(report[1]);
+        Sample sample;
+        if (decode_ && traced_decode_(captured, sample)) {
+            auto const &q = sample.orientation;
+            *os_ << " Orientation (w x y z): " << q.w << " " << q.x << " "
+                 << q.y << " " << q.z;
+            if (sample.hasAngularVelocity) {
+                auto v = sample.angular_velocity();
+                *os_ << " Angular velocity (rad/s): " << v.x << " " << v.y
+                     << " " << v.z;
+            }
+        }
+        *os_ << "\n";
+    }
+
+    /// Flushes the output. Returns false if any write failed.
+    bool finish() {
+        os_->flush();
+        return !os_->fail();
+    }
+
+  private:
+    bool traced_decode_(CapturedReport const &captured, Sample &sample) {
+        TraceScope trace(TracePoint::Decode, captured.report[1]);
+        return decode(captured, sample);
+    }
+
+    void write_anchor_(ClockAnchor const &anchor) {
+        *os_ << prefix_ << "Clock anchor: monotonic timestamp "
+             << anchor.monotonic << " ns = wall clock " << anchor.wallClock
+             << " ns since the Unix epoch\n";
+    }
+
+    std::ofstream file_;
+    std::ostream *os_;
+    std::string prefix_;
+    bool decode_ = false;
+};
+} // namespace hdklogger
+
+#endif // INCLUDED_TextWriter_h_GUID_A9233736_D432_46A0_AC1B_F7440ED819E9
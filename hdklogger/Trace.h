@@ -0,0 +1,363 @@
+/** @file
+    @brief Header defining lightweight trace points for following reports
+    through the capture pipeline, exportable as a Chrome trace.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Trace_h_GUID_C9A1B217_BAC8_4DAF_B91F_F8E86AD2B2D8
+#define INCLUDED_Trace_h_GUID_C9A1B217_BAC8_4DAF_B91F_F8E86AD2B2D8
+
+// Internal Includes
+#include "Clock.h"
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <algorithm>
+#include <atomic>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Set to 0 to compile out every trace point: see the HDKLOGGER_TRACING
+/// CMake option. Otherwise tracing still costs only a relaxed load and a
+/// branch per trace point until it is enabled at runtime.
+#ifndef HDKLOGGER_TRACING
+#define HDKLOGGER_TRACING 1
+#endif
+
+namespace hdklogger {
+/// Places in the pipeline that can be traced.
+enum class TracePoint : std::uint8_t {
+    /// A report read from the backend, at the time it was timestamped.
+    Receive,
+    /// A DeviceBase::read_batch() call that returned reports.
+    Read,
+    /// Putting a batch of reports into the ring.
+    Enqueue,
+    /// Taking reports off the ring and into the sink.
+    Dequeue,
+    /// Decoding a report.
+    Decode,
+    /// Formatting a report as text.
+    Format,
+    /// Compressing a block of records.
+    Compress,
+    /// Writing buffered output to the file.
+    Write,
+    /// Syncing the file to storage.
+    Sync
+};
+
+static const std::size_t TRACE_POINT_COUNT = 9;
+
+inline const char *to_string(TracePoint point) {
+    static const char *const NAMES[TRACE_POINT_COUNT] = {
+        "receive", "read", "enqueue", "dequeue", "decode",
+        "format",  "compress", "write", "sync"};
+    return NAMES[std::size_t(point)];
+}
+
+/// What the number recorded with each trace point counts.
+inline const char *trace_arg_name(TracePoint point) {
+    static const char *const NAMES[TRACE_POINT_COUNT] = {
+        "sequence", "reports", "reports", "reports", "sequence",
+        "sequence", "records", "bytes",   "bytes"};
+    return NAMES[std::size_t(point)];
+}
+
+/// Default number of events kept per thread: the most recent are kept.
+static const std::size_t DEFAULT_TRACE_EVENTS = std::size_t(1) << 18;
+
+/// Most events that may be kept per thread: each thread's buffer is
+/// allocated up front, and this many events take 512 MiB.
+static const std::size_t MAX_TRACE_EVENTS = std::size_t(1) << 24;
+
+/// One traced event: a span if its duration is non-zero, or else an instant.
+struct TraceEvent {
+    /// Start, from monotonic_now().
+    std::int64_t timestamp;
+    /// Duration in nanoseconds.
+    std::int64_t duration;
+    TracePoint point;
+    std::uint64_t arg;
+};
+
+/// The most recent events traced by one thread, in a ring. Only that thread
+/// records into it, without locking; snapshot() may be called from any
+/// thread meanwhile.
+class TraceBuffer {
+  public:
+    TraceBuffer(std::size_t capacity, std::uint32_t tid)
+        : capacity_(std::max(capacity, std::size_t(1))),
+          slots_(new Slot[capacity_]), tid_(tid) {}
+
+    TraceBuffer(TraceBuffer const &) = delete;
+    TraceBuffer &operator=(TraceBuffer const &) = delete;
+
+    /// Owning thread only.
+    void record(TracePoint point, std::int64_t timestamp,
+                std::int64_t duration, std::uint64_t arg) {
+        auto n = recorded_.load(std::memory_order_relaxed);
+        auto &slot = slots_[n % capacity_];
+        /// Invalidate the slot while it is being rewritten.
+        slot.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.timestamp.store(timestamp, std::memory_order_relaxed);
+        slot.duration.store(duration, std::memory_order_relaxed);
+        slot.meta.store(std::uint64_t(point) | (arg << 8),
+                        std::memory_order_relaxed);
+        slot.seq.store(n + 1, std::memory_order_release);
+        recorded_.store(n + 1, std::memory_order_release);
+    }
+
+    /// Appends the events currently held, oldest first, to @p events.
+    /// Events being overwritten as this runs are skipped. Returns how many
+    /// events have been overwritten (lost) so far.
+    std::uint64_t snapshot(std::vector<TraceEvent> &events) const {
+        auto end = recorded_.load(std::memory_order_acquire);
+        auto begin = end > capacity_ ? end - capacity_ : 0;
+        for (auto n = begin; n < end; ++n) {
+            auto const &slot = slots_[n % capacity_];
+            if (slot.seq.load(std::memory_order_acquire) != n + 1) {
+                continue;
+            }
+            TraceEvent event;
+            event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+            event.duration = slot.duration.load(std::memory_order_relaxed);
+            auto meta = slot.meta.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != n + 1) {
+                continue;
+            }
+            event.point = TracePoint(meta & 0xff);
+            event.arg = meta >> 8;
+            events.push_back(event);
+        }
+        return begin;
+    }
+
+    std::uint32_t tid() const { return tid_; }
+
+    /// Name of the thread, for the trace viewer. Set through
+    /// Tracer::name_thread().
+    std::string const &name() const { return name_; }
+    void set_name(std::string const &name) { name_ = name; }
+
+  private:
+    struct Slot {
+        /// Index of the event held, plus one: 0 while being written.
+        std::atomic<std::uint64_t> seq{0};
+        std::atomic<std::int64_t> timestamp{0};
+        std::atomic<std::int64_t> duration{0};
+        std::atomic<std::uint64_t> meta{0};
+    };
+    std::size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<std::uint64_t> recorded_{0};
+    std::uint32_t tid_;
+    std::string name_;
+};
+
+/// Process-wide tracing state: whether it is on, and every thread's buffer.
+/// Buffers outlive their threads, so a trace can be exported after the
+/// capture has finished.
+class Tracer {
+  public:
+    static Tracer &instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    /// Turns tracing on, keeping the last @p eventsPerThread events of each
+    /// thread.
+    void enable(std::size_t eventsPerThread = DEFAULT_TRACE_EVENTS) {
+        eventsPerThread_ = eventsPerThread;
+        enabled_.store(true, std::memory_order_release);
+    }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /// Names the calling thread in the trace.
+    void name_thread(std::string const &name) {
+        auto &mine = buffer();
+        std::lock_guard<std::mutex> lock(mutex_);
+        mine.set_name(name);
+    }
+
+    /// The calling thread's buffer, created on first use.
+    TraceBuffer &buffer() {
+        static thread_local TraceBuffer *mine = nullptr;
+        if (!mine) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.emplace_back(new TraceBuffer{
+                eventsPerThread_, std::uint32_t(buffers_.size() + 1)});
+            mine = buffers_.back().get();
+        }
+        return *mine;
+    }
+
+    /// Writes everything traced so far as a Chrome trace (JSON), which
+    /// chrome://tracing and Perfetto can open. May be called while threads
+    /// are still tracing. Returns false if the file can't be written.
+    bool write_chrome_trace(std::string const &path,
+                            std::uint64_t *lost = nullptr) {
+        std::unique_ptr<std::FILE, FileCloser> file{
+            std::fopen(path.c_str(), "w")};
+        if (!file) {
+            return false;
+        }
+        auto f = file.get();
+        std::fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        std::uint64_t totalLost = 0;
+        bool first = true;
+        std::vector<TraceEvent> events;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto const &buffer : buffers_) {
+            std::fprintf(f,
+                         "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                         "\"tid\":%u,\"args\":{\"name\":\"",
+                         first ? "" : ",\n", unsigned(buffer->tid()));
+            first = false;
+            write_escaped_(f, buffer->name().empty()
+                                  ? "thread " + std::to_string(buffer->tid())
+                                  : buffer->name());
+            std::fprintf(f, "\"}}");
+            events.clear();
+            totalLost += buffer->snapshot(events);
+            for (auto const &event : events) {
+                /// Microseconds, to the nanosecond.
+                std::fprintf(f,
+                             ",\n{\"name\":\"%s\",\"cat\":\"hdklogger\","
+                             "\"pid\":1,\"tid\":%u,\"ts\":%lld.%03d,",
+                             to_string(event.point), unsigned(buffer->tid()),
+                             (long long)(event.timestamp / 1000),
+                             int(event.timestamp % 1000));
+                if (event.duration > 0) {
+                    std::fprintf(f, "\"ph\":\"X\",\"dur\":%lld.%03d,",
+                                 (long long)(event.duration / 1000),
+                                 int(event.duration % 1000));
+                } else {
+                    std::fprintf(f, "\"ph\":\"i\",\"s\":\"t\",");
+                }
+                std::fprintf(f, "\"args\":{\"%s\":%llu}}",
+                             trace_arg_name(event.point),
+                             (unsigned long long)event.arg);
+            }
+        }
+        std::fprintf(f, "\n]}\n");
+        if (lost) {
+            *lost = totalLost;
+        }
+        return 0 == std::ferror(f) && 0 == std::fclose(file.release());
+    }
+
+  private:
+    Tracer() = default;
+
+    struct FileCloser {
+        void operator()(std::FILE *f) { std::fclose(f); }
+    };
+
+    static void write_escaped_(std::FILE *f, std::string const &s) {
+        for (auto c : s) {
+            if (c == '"' || c == '\\') {
+                std::fputc('\\', f);
+                std::fputc(c, f);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                std::fprintf(f, "\\u%04x", unsigned(c));
+            } else {
+                std::fputc(c, f);
+            }
+        }
+    }
+
+    std::atomic<bool> enabled_{false};
+    std::size_t eventsPerThread_ = DEFAULT_TRACE_EVENTS;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+};
+
+/// Is tracing on?
+inline bool tracing() {
+    return HDKLOGGER_TRACING && Tracer::instance().enabled();
+}
+
+/// @name Trace points
+/// @brief Each does nothing unless tracing is on.
+/// @{
+/// Records an instant at @p timestamp.
+inline void trace_instant(TracePoint point, std::int64_t timestamp,
+                          std::uint64_t arg = 0) {
+    if (tracing()) {
+        Tracer::instance().buffer().record(point, timestamp, 0, arg);
+    }
+}
+
+/// Records a span from @p start to @p end.
+inline void trace_span(TracePoint point, std::int64_t start, std::int64_t end,
+                       std::uint64_t arg = 0) {
+    if (tracing()) {
+        Tracer::instance().buffer().record(point, start,
+                                           std::max(end - start,
+                                                    std::int64_t(1)),
+                                           arg);
+    }
+}
+
+/// Names the calling thread in the trace.
+inline void trace_thread_name(std::string const &name) {
+    if (tracing()) {
+        Tracer::instance().name_thread(name);
+    }
+}
+
+/// Records a span covering its own lifetime.
+class TraceScope {
+  public:
+    explicit TraceScope(TracePoint point, std::uint64_t arg = 0)
+        : point_(point), arg_(arg), start_(tracing() ? monotonic_now() : 0) {}
+    ~TraceScope() {
+        if (start_) {
+            trace_span(point_, start_, monotonic_now(), arg_);
+        }
+    }
+    TraceScope(TraceScope const &) = delete;
+    TraceScope &operator=(TraceScope const &) = delete;
+
+    /// Sets the number recorded with the span, if only known at the end.
+    void set_arg(std::uint64_t arg) { arg_ = arg; }
+
+  private:
+    TracePoint point_;
+    std::uint64_t arg_;
+    std::int64_t start_;
+};
+/// @}
+} // namespace hdklogger
+
+#endif // INCLUDED_Trace_h_GUID_C9A1B217_BAC8_4DAF_B91F_F8E86AD2B2D8
@@ -27,6 +27,7 @@
 
 // Internal Includes
 #include "HandleError.h"
+#include "Report.h"
 
 // Library/third-party includes
 #include <hidapi.h>
@@ -36,7 +37,10 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <algorithm>
+#include <utility>
 #include <cstddef> // for std::size_t
+#include <cstdint>
 
 namespace hidapi {
 namespace detail {
@@ -54,7 +58,6 @@ namespace detail {
     using DeviceSharedPtr = std::shared_ptr<hid_device>;
 } // namespace detail
 
-using DataByte = unsigned char;
 using DataVector = std::vector<DataByte>;
 
 /// @name Non-throwing data types and methods
@@ -62,10 +65,16 @@ using DataVector = std::vector<DataByte>;
 /// @{
 using DataResult = std::pair<DataVector, const wchar_t *>;
 
-inline bool had_error(DataResult const &result) {
+/// Result of non-throwing calls that fill a caller-owned buffer: the number of
+/// bytes placed in the buffer, and the error message (if any).
+using SizeResult = std::pair<std::size_t, const wchar_t *>;
+
+template <typename T>
+inline bool had_error(std::pair<T, const wchar_t *> const &result) {
     return nullptr != result.second;
 }
-inline const wchar_t *get_error(DataResult const &result) {
+template <typename T>
+inline const wchar_t *get_error(std::pair<T, const wchar_t *> const &result) {
     return result.second;
 }
 
@@ -78,16 +87,21 @@ inline DataVector &get_data(DataResult &result) { return result.first; }
 inline DataVector &&get_data(DataResult &&result) {
     return std::move(result.first);
 }
-/// @}
 
-static const std::size_t DEFAULT_MAX_LENGTH = 512;
+inline std::size_t get_size(SizeResult const &result) { return result.first; }
+/// @}
 
 /// CRTP base class for device objects: provides common functionality for
 /// C++-wrapped HIDAPI devices.
+///
+/// The actual I/O goes through the `*_impl()` customization points below,
+/// which by default call HIDAPI on the device returned by `get()`. A derived
+/// class not backed by HIDAPI shadows them (befriending this base class if
+/// it keeps them private).
 template <typename Derived> class DeviceBase {
   public:
     /// Checks for validity of the object.
-    explicit operator bool() const { return (nullptr != get_()); }
+    explicit operator bool() const { return derived().valid_impl(); }
 
     /// Accessor for the raw HIDAPI opaque object, for functions that aren't
     /// wrapped.
@@ -109,22 +123,129 @@ template <typename Derived> class DeviceBase {
     /// error message.
     DataResult read(std::size_t maxLength = DEFAULT_MAX_LENGTH) {
         auto data = DataVector(maxLength);
-        auto result = hid_read(get(), data.data(), maxLength);
+        auto result = derived().read_impl(data.data(), maxLength);
         return handle_buffer(std::move(data), result);
     }
 
+    /// Reads a HID report, if available, into a caller-owned buffer without
+    /// allocating.
+    ///
+    /// The first value returned is the number of bytes placed in @p buf: 0
+    /// means nothing available. Errors are reported as in read() above.
+    SizeResult read(DataByte *buf, std::size_t maxLength) {
+        auto result = derived().read_impl(buf, maxLength);
+        return handle_size(result);
+    }
+
+    /// @overload
+    template <std::size_t N> SizeResult read(DataByte (&buf)[N]) {
+        return read(buf, N);
+    }
+
     /// Gets a HID feature report.
     ///
     /// The supplied report ID will be the first byte of the returned data
     /// vector.
-    DataVector get_feature_report(unsigned char reportId,
+    DataResult get_feature_report(unsigned char reportId,
                                   std::size_t maxLength = DEFAULT_MAX_LENGTH) {
         auto data = DataVector(maxLength + 1);
         data[0] = reportId;
-        auto result = hid_getFeatureReport(get(), data.data(), maxLength);
+        auto result =
+            derived().get_feature_report_impl(data.data(), data.size());
         return handle_buffer(std::move(data), result);
     }
 
+    /// Reads a HID report, if available, into a fixed-capacity inline report
+    /// without allocating.
+    ///
+    /// The report is resized to the data read (empty on error or if nothing
+    /// was available).
+    template <std::size_t N> SizeResult read(Report<N> &report) {
+        auto result = read(report.data(), report.capacity());
+        report.resize(get_size(result));
+        return result;
+    }
+
+    /// Reads a HID report into a caller-owned buffer, waiting at most
+    /// @p milliseconds for one to arrive (-1 waits indefinitely).
+    ///
+    /// @sa DeviceBase::read(DataByte *, std::size_t)
+    SizeResult read_timeout(DataByte *buf, std::size_t maxLength,
+                            int milliseconds) {
+        auto result = derived().read_timeout_impl(buf, maxLength, milliseconds);
+        return handle_size(result);
+    }
+
+    /// @overload
+    template <std::size_t N>
+    SizeResult read_timeout(Report<N> &report, int milliseconds) {
+        auto result =
+            read_timeout(report.data(), report.capacity(), milliseconds);
+        report.resize(get_size(result));
+        return result;
+    }
+
+    /// Reads every report already waiting, up to @p maxReports, in one call,
+    /// waiting at most @p milliseconds (-1 waits indefinitely) for the first.
+    ///
+    /// The reports go in a caller-owned contiguous block of @p maxReports
+    /// slots of @p stride bytes each. The length of each goes in @p lengths
+    /// and, unless @p timestamps is null, the result of calling @p now just
+    /// after it was read goes in @p timestamps.
+    ///
+    /// The first value returned is the number of reports read: 0 means
+    /// nothing available. An error is reported as in read() above, along with
+    /// any reports read before it.
+    template <typename Clock>
+    SizeResult read_batch(DataByte *buf, std::size_t stride,
+                          std::size_t maxReports, std::size_t *lengths,
+                          std::int64_t *timestamps, int milliseconds,
+                          Clock &&now) {
+        std::size_t count = 0;
+        auto result = derived().read_batch_impl(
+            buf, stride, maxReports, lengths, timestamps, milliseconds, now,
+            count);
+        return SizeResult{count,
+                          result < 0 ? derived().error_impl() : nullptr};
+    }
+
+    /// @overload
+    /// Reads into a ReportBatch, replacing its contents, up to @p maxReports
+    /// reports (or its capacity, if less).
+    template <std::size_t N, typename Clock>
+    SizeResult read_batch(ReportBatch<N> &batch, std::size_t maxReports,
+                          int milliseconds, Clock &&now) {
+        auto result = read_batch(batch.data(), N,
+                                 std::min(maxReports, batch.capacity()),
+                                 batch.lengths(), batch.timestamps(),
+                                 milliseconds, std::forward<Clock>(now));
+        batch.resize(get_size(result));
+        return result;
+    }
+
+    /// @overload
+    /// Reads up to the batch's capacity.
+    template <std::size_t N, typename Clock>
+    SizeResult read_batch(ReportBatch<N> &batch, int milliseconds,
+                          Clock &&now) {
+        return read_batch(batch, batch.capacity(), milliseconds,
+                          std::forward<Clock>(now));
+    }
+
+    /// Gets a HID feature report into a fixed-capacity inline report without
+    /// allocating.
+    ///
+    /// The supplied report ID will be the first byte of the report.
+    template <std::size_t N>
+    SizeResult get_feature_report(unsigned char reportId, Report<N> &report) {
+        report[0] = reportId;
+        auto result =
+            derived().get_feature_report_impl(report.data(), report.capacity());
+        auto ret = handle_size(result);
+        report.resize(get_size(ret));
+        return ret;
+    }
+
     /// @}
 
     /// @name Throwing methods
@@ -136,11 +257,19 @@ template <typename Derived> class DeviceBase {
     /// Reads a HID report, if available.
     ///
     /// @sa DeviceBase::read()
-    DataResult read_throwing(std::size_t maxLength = DEFAULT_MAX_LENGTH) {
+    DataVector read_throwing(std::size_t maxLength = DEFAULT_MAX_LENGTH) {
         auto data = DataVector(maxLength);
-        auto result = hid_read(get(), data.data(), maxLength);
+        auto result = derived().read_impl(data.data(), maxLength);
         return handle_buffer_and_throw(std::move(data), result);
     }
+    /// Reads a HID report, if available, into a caller-owned buffer without
+    /// allocating, returning the number of bytes read.
+    ///
+    /// @sa DeviceBase::read(DataByte *, std::size_t)
+    std::size_t read_throwing(DataByte *buf, std::size_t maxLength) {
+        auto result = derived().read_impl(buf, maxLength);
+        return handle_size_and_throw(result);
+    }
     /// Gets a HID feature report.
     ///
     /// @sa DeviceBase::get_feature_report()
@@ -149,18 +278,95 @@ template <typename Derived> class DeviceBase {
                                 std::size_t maxLength = DEFAULT_MAX_LENGTH) {
         auto data = DataVector(maxLength + 1);
         data[0] = reportId;
-        auto result = hid_getFeatureReport(get(), data.data(), maxLength);
+        auto result =
+            derived().get_feature_report_impl(data.data(), data.size());
         return handle_buffer_and_throw(std::move(data), result);
     }
+
+    /// Reads a HID report, if available, into a fixed-capacity inline report
+    /// without allocating, returning the number of bytes read.
+    ///
+    /// @sa DeviceBase::read(Report<N> &)
+    template <std::size_t N> std::size_t read_throwing(Report<N> &report) {
+        report.clear();
+        auto size = read_throwing(report.data(), report.capacity());
+        report.resize(size);
+        return size;
+    }
+
+    /// Gets a HID feature report into a fixed-capacity inline report without
+    /// allocating, returning the number of bytes read.
+    ///
+    /// @sa DeviceBase::get_feature_report(unsigned char, Report<N> &)
+    template <std::size_t N>
+    std::size_t get_feature_report_throwing(unsigned char reportId,
+                                            Report<N> &report) {
+        report.clear();
+        report[0] = reportId;
+        auto result =
+            derived().get_feature_report_impl(report.data(), report.capacity());
+        auto size = handle_size_and_throw(result);
+        report.resize(size);
+        return size;
+    }
     /// @}
 
     using derived_type = Derived;
 
+  protected:
+    /// @name Customization points
+    /// @brief Default implementations, using HIDAPI. Integer results follow
+    /// HIDAPI conventions: bytes transferred, or negative on error, in which
+    /// case error_impl() is called to get a message.
+    /// @{
+    bool valid_impl() const { return nullptr != get_(); }
+    int read_impl(DataByte *buf, std::size_t maxLength) {
+        return hid_read(get(), buf, maxLength);
+    }
+    int read_timeout_impl(DataByte *buf, std::size_t maxLength,
+                          int milliseconds) {
+        return hid_read_timeout(get(), buf, maxLength, milliseconds);
+    }
+    int get_feature_report_impl(DataByte *buf, std::size_t length) {
+        return hid_get_feature_report(get(), buf, length);
+    }
+    const wchar_t *error_impl() { return detail::handle_error(*get()); }
+    /// Reads a batch of reports: see read_batch(). Sets @p count to the
+    /// number read, and returns 0, or negative on an error after those.
+    ///
+    /// HIDAPI has no call returning several reports, so by default this
+    /// calls read_timeout_impl() until nothing more is waiting. A derived
+    /// class that can do better shadows it.
+    template <typename Clock>
+    int read_batch_impl(DataByte *buf, std::size_t stride,
+                        std::size_t maxReports, std::size_t *lengths,
+                        std::int64_t *timestamps, int milliseconds, Clock &now,
+                        std::size_t &count) {
+        for (count = 0; count < maxReports; ++count) {
+            auto result = derived().read_timeout_impl(
+                buf + count * stride, stride, count == 0 ? milliseconds : 0);
+            if (result <= 0) {
+                return result;
+            }
+            lengths[count] = static_cast<std::size_t>(result);
+            if (timestamps) {
+                timestamps[count] = now();
+            }
+        }
+        return 0;
+    }
+    /// @}
+
   private:
+    derived_type &derived() { return *static_cast<derived_type *>(this); }
+    derived_type const &derived() const {
+        return *static_cast<derived_type const *>(this);
+    }
+
     const wchar_t *handle_buffer_base(DataVector &data, int callResult) {
         const wchar_t *ret = nullptr;
         if (callResult < 0) {
-            ret = detail::handle_error(*get());
+            ret = derived().error_impl();
         } else {
             data.resize(callResult);
         }
@@ -183,6 +389,20 @@ template <typename Derived> class DeviceBase {
         return std::move(data);
     }
 
+    SizeResult handle_size(int callResult) {
+        if (callResult < 0) {
+            return SizeResult{0, derived().error_impl()};
+        }
+        return SizeResult{static_cast<std::size_t>(callResult), nullptr};
+    }
+
+    std::size_t handle_size_and_throw(int callResult) {
+        if (callResult < 0) {
+            detail::handle_error_throwing(derived().error_impl());
+        }
+        return static_cast<std::size_t>(callResult);
+    }
+
     /// Function used by CTRP to get HIDAPI opaque pointer from derived class.
     hid_device *get_() const {
         return static_cast<derived_type const *>(this)->get();
@@ -0,0 +1,167 @@
+/** @file
+    @brief Header defining a fixed-capacity HID report buffer stored inline.
+
+    @date 2015
+
+    @author
+    Sensics, Inc.
+    <http://sensics.com/osvr>
+*/
+
+// Copyright 2015 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCLUDED_Report_h_GUID_5D2E0C27_4CC8_45ED_A562_FA2F593E40C8
+#define INCLUDED_Report_h_GUID_5D2E0C27_4CC8_45ED_A562_FA2F593E40C8
+
+// Internal Includes
+// - none
+
+// Library/third-party includes
+// - none
+
+// Standard includes
+#include <array>
+#include <cassert>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <memory>
+
+namespace hidapi {
+using DataByte = unsigned char;
+
+static const std::size_t DEFAULT_MAX_LENGTH = 512;
+
+/// A HID report buffer with a compile-time maximum length, stored inline
+/// rather than on the heap: small reports stay in cache and reading one never
+/// touches the allocator.
+///
+/// Usable with DeviceBase::read() and DeviceBase::get_feature_report().
+template <std::size_t MaxLength> class Report {
+  public:
+    static_assert(MaxLength > 0, "A report must be able to hold a byte.");
+    using value_type = DataByte;
+    using iterator = DataByte *;
+    using const_iterator = DataByte const *;
+
+    /// Maximum length of a report in this buffer.
+    static std::size_t capacity() { return MaxLength; }
+
+    /// Length of the report currently held.
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return 0 == size_; }
+
+    /// Sets the length of the report currently held: used after filling
+    /// data() directly.
+    void resize(std::size_t size) {
+        assert(size <= MaxLength && "Report length exceeds capacity!");
+        size_ = size;
+    }
+
+    void clear() { size_ = 0; }
+
+    DataByte *data() { return data_.data(); }
+    DataByte const *data() const { return data_.data(); }
+
+    DataByte &operator[](std::size_t i) { return data_[i]; }
+    DataByte const &operator[](std::size_t i) const { return data_[i]; }
+
+    iterator begin() { return data(); }
+    iterator end() { return data() + size_; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + size_; }
+
+  private:
+    std::array<DataByte, MaxLength> data_;
+    std::size_t size_ = 0;
+};
+
+/// A batch of HID reports, each with the time it was read, for
+/// DeviceBase::read_batch() to fill without allocating.
+///
+/// All storage is allocated once, in the constructor: the reports themselves
+/// are in one contiguous block of capacity() slots of MaxLength bytes each,
+/// with their lengths and timestamps in parallel arrays.
+template <std::size_t MaxLength> class ReportBatch {
+  public:
+    static_assert(MaxLength > 0, "A report must be able to hold a byte.");
+
+    explicit ReportBatch(std::size_t capacity)
+        : capacity_(capacity), data_(new DataByte[capacity * MaxLength]),
+          lengths_(new std::size_t[capacity]),
+          timestamps_(new std::int64_t[capacity]) {}
+
+    /// Maximum length of each report in this batch.
+    static std::size_t max_length() { return MaxLength; }
+
+    /// Maximum number of reports in this batch.
+    std::size_t capacity() const { return capacity_; }
+
+    /// Number of reports currently held.
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return 0 == size_; }
+
+    /// Sets the number of reports currently held: used after filling the
+    /// arrays directly.
+    void resize(std::size_t size) {
+        assert(size <= capacity_ && "Batch size exceeds capacity!");
+        size_ = size;
+    }
+
+    void clear() { size_ = 0; }
+
+    /// @name Whole arrays
+    /// @{
+    DataByte *data() { return data_.get(); }
+    std::size_t *lengths() { return lengths_.get(); }
+    std::int64_t *timestamps() { return timestamps_.get(); }
+    /// @}
+
+    /// @name Individual reports
+    /// @{
+    DataByte const *data(std::size_t i) const {
+        return data_.get() + i * MaxLength;
+    }
+    std::size_t length(std::size_t i) const { return lengths_[i]; }
+    std::int64_t timestamp(std::size_t i) const { return timestamps_[i]; }
+    /// @}
+
+  private:
+    std::size_t capacity_;
+    std::size_t size_ = 0;
+    std::unique_ptr<DataByte[]> data_;
+    std::unique_ptr<std::size_t[]> lengths_;
+    std::unique_ptr<std::int64_t[]> timestamps_;
+};
+
+/// Traits describing the reports of a device identified by VID and PID.
+///
+/// Specialize for known devices to give them a tighter compile-time maximum
+/// report length.
+template <unsigned short VID, unsigned short PID> struct DeviceReportTraits {
+    static const std::size_t max_length = DEFAULT_MAX_LENGTH;
+};
+
+/// The fixed-capacity report type suitable for a given device.
+template <unsigned short VID, unsigned short PID>
+using ReportFor = Report<DeviceReportTraits<VID, PID>::max_length>;
+
+/// The report batch type suitable for a given device.
+template <unsigned short VID, unsigned short PID>
+using ReportBatchFor = ReportBatch<DeviceReportTraits<VID, PID>::max_length>;
+} // namespace hidapi
+
+#endif // INCLUDED_Report_h_GUID_5D2E0C27_4CC8_45ED_A562_FA2F593E40C8